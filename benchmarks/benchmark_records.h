@@ -0,0 +1,105 @@
+// MIT License
+//
+// Copyright (c) 2023 Ioannis Kaliakatsos
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "database.h"
+
+#include "person.h"
+#include "pet.h"
+#include "company.h"
+#include "datetime_container.h"
+
+namespace sqlite_reflection {
+	/// Creates a record of the given type with the given id, whose members depend on the id
+	template <typename T>
+	T MakeRecord(int64_t id);
+
+	template <>
+	inline Person MakeRecord<Person>(int64_t id) {
+		return Person{L"name" + std::to_wstring(id % 100), L"surname" + std::to_wstring(id), id % 90, id % 2 == 0, id};
+	}
+
+	template <>
+	inline Pet MakeRecord<Pet>(int64_t id) {
+		return Pet{L"pet" + std::to_wstring(id), 0.1 * (id % 400), id};
+	}
+
+	template <>
+	inline Company MakeRecord<Company>(int64_t id) {
+		return Company{L"company" + std::to_wstring(id), id % 60, L"street " + std::to_wstring(id % 1000), 1000.0 * (id % 80), id};
+	}
+
+	template <>
+	inline DatetimeContainer MakeRecord<DatetimeContainer>(int64_t id) {
+		DatetimeContainer container;
+		container.creation_date = TimePoint(1600000000 + id * 60);
+		container.id = id;
+		return container;
+	}
+
+	/// Creates the given number of records of the given type, with ids starting from the given id
+	template <typename T>
+	std::vector<T> MakeRecords(int64_t count, int64_t first_id = 1) {
+		std::vector<T> records;
+		records.reserve(count);
+		for (auto id = first_id; id < first_id + count; ++id) {
+			records.push_back(MakeRecord<T>(id));
+		}
+		return records;
+	}
+
+	/// Initializes an in-memory database, in which the given number of records
+	/// of the given type are saved, and finalizes it when going out of scope
+	template <typename T>
+	class PopulatedDatabase
+	{
+	public:
+		explicit PopulatedDatabase(int64_t count) {
+			Database::Initialize("");
+			if (count > 0) {
+				Database::Instance().Save(MakeRecords<T>(count));
+			}
+		}
+
+		~PopulatedDatabase() {
+			Database::Finalize();
+		}
+
+		const Database& Instance() const {
+			return Database::Instance();
+		}
+	};
+}
+
+/// The table sizes at which all database benchmarks are run
+#define TABLE_SIZES ->Arg(10)->Arg(1000)->Arg(10000)
+
+/// Registers a database benchmark for all record types of the tests
+#define BENCHMARK_ALL_RECORDS(func) \
+	BENCHMARK_TEMPLATE(func, Person) TABLE_SIZES; \
+	BENCHMARK_TEMPLATE(func, Pet) TABLE_SIZES; \
+	BENCHMARK_TEMPLATE(func, Company) TABLE_SIZES; \
+	BENCHMARK_TEMPLATE(func, DatetimeContainer) TABLE_SIZES
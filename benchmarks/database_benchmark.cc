@@ -0,0 +1,144 @@
+// MIT License
+//
+// Copyright (c) 2023 Ioannis Kaliakatsos
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <benchmark/benchmark.h>
+
+#include "benchmark_records.h"
+
+using namespace sqlite_reflection;
+
+template <typename T>
+static void BM_SaveSingle(benchmark::State& state) {
+	const auto table_size = state.range(0);
+	PopulatedDatabase<T> populated(table_size);
+	const Database& db = populated.Instance();
+	auto id = table_size;
+	for (auto _ : state) {
+		db.Save(MakeRecord<T>(++id));
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_ALL_RECORDS(BM_SaveSingle);
+
+template <typename T>
+static void BM_SaveBulk(benchmark::State& state) {
+	const auto count = state.range(0);
+	PopulatedDatabase<T> populated(0);
+	const Database& db = populated.Instance();
+	const auto records = MakeRecords<T>(count);
+	const EmptyPredicate all;
+	for (auto _ : state) {
+		db.Save(records);
+		state.PauseTiming();
+		db.Delete<T>(&all);
+		state.ResumeTiming();
+	}
+	state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK_ALL_RECORDS(BM_SaveBulk);
+
+template <typename T>
+static void BM_SaveAutoIncrement(benchmark::State& state) {
+	PopulatedDatabase<T> populated(state.range(0));
+	const Database& db = populated.Instance();
+	const auto record = MakeRecord<T>(0);
+	for (auto _ : state) {
+		db.SaveAutoIncrement(record);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_ALL_RECORDS(BM_SaveAutoIncrement);
+
+template <typename T>
+static void BM_Update(benchmark::State& state) {
+	const auto table_size = state.range(0);
+	PopulatedDatabase<T> populated(table_size);
+	const Database& db = populated.Instance();
+	int64_t i = 0;
+	for (auto _ : state) {
+		auto record = MakeRecord<T>(i % table_size + 1);
+		record.id = i++ % table_size + 1;
+		db.Update(record);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_ALL_RECORDS(BM_Update);
+
+template <typename T>
+static void BM_DeleteById(benchmark::State& state) {
+	const auto table_size = state.range(0);
+	PopulatedDatabase<T> populated(table_size);
+	const Database& db = populated.Instance();
+	int64_t i = 0;
+	for (auto _ : state) {
+		const auto id = i++ % table_size + 1;
+		db.Delete<T>(id);
+		state.PauseTiming();
+		db.Save(MakeRecord<T>(id));
+		state.ResumeTiming();
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_ALL_RECORDS(BM_DeleteById);
+
+template <typename T>
+static void BM_DeleteByPredicate(benchmark::State& state) {
+	const auto table_size = state.range(0);
+	PopulatedDatabase<T> populated(table_size);
+	const Database& db = populated.Instance();
+	// deletes the upper tenth of the table
+	const auto first_deleted_id = table_size - table_size / 10 + 1;
+	const GreaterThanOrEqual predicate(&T::id, first_deleted_id);
+	for (auto _ : state) {
+		db.Delete<T>(&predicate);
+		state.PauseTiming();
+		db.Save(MakeRecords<T>(table_size / 10, first_deleted_id));
+		state.ResumeTiming();
+	}
+	state.SetItemsProcessed(state.iterations() * (table_size / 10));
+}
+BENCHMARK_ALL_RECORDS(BM_DeleteByPredicate);
+
+template <typename T>
+static void BM_FetchAll(benchmark::State& state) {
+	const auto table_size = state.range(0);
+	PopulatedDatabase<T> populated(table_size);
+	const Database& db = populated.Instance();
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(db.FetchAll<T>());
+	}
+	state.SetItemsProcessed(state.iterations() * table_size);
+}
+BENCHMARK_ALL_RECORDS(BM_FetchAll);
+
+template <typename T>
+static void BM_FetchById(benchmark::State& state) {
+	const auto table_size = state.range(0);
+	PopulatedDatabase<T> populated(table_size);
+	const Database& db = populated.Instance();
+	int64_t i = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(db.Fetch<T>(i++ % table_size + 1));
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_ALL_RECORDS(BM_FetchById);
@@ -0,0 +1,109 @@
+// MIT License
+//
+// Copyright (c) 2023 Ioannis Kaliakatsos
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <benchmark/benchmark.h>
+
+#include "query_predicates.h"
+#include "query_expressions.h"
+#include "time_point.h"
+#include "internal/string_utilities.h"
+
+#include "person.h"
+
+using namespace sqlite_reflection;
+
+static void BM_PredicateConstruction(benchmark::State& state) {
+	for (auto _ : state) {
+		const auto predicate = GreaterThanOrEqual(&Person::id, 2)
+		                       .And(SmallerThan(&Person::id, 5))
+		                       .And(Equal(&Person::first_name, L"john"));
+		benchmark::DoNotOptimize(predicate);
+	}
+}
+BENCHMARK(BM_PredicateConstruction);
+
+static void BM_PredicateEvaluation(benchmark::State& state) {
+	const auto predicate = GreaterThanOrEqual(&Person::id, 2)
+	                       .And(SmallerThan(&Person::id, 5))
+	                       .And(Equal(&Person::first_name, L"john"));
+	for (auto _ : state) {
+		std::vector<QueryParameter> parameters;
+		benchmark::DoNotOptimize(predicate.Evaluate(parameters));
+	}
+}
+BENCHMARK(BM_PredicateEvaluation);
+
+static void BM_ExpressionConstruction(benchmark::State& state) {
+	for (auto _ : state) {
+		const auto predicate = col(&Person::id) >= 2 && col(&Person::id) < 5 && col(&Person::first_name) == L"john";
+		benchmark::DoNotOptimize(predicate);
+	}
+}
+BENCHMARK(BM_ExpressionConstruction);
+
+static void BM_ExpressionEvaluation(benchmark::State& state) {
+	const auto predicate = col(&Person::id) >= 2 && col(&Person::id) < 5 && col(&Person::first_name) == L"john";
+	for (auto _ : state) {
+		std::vector<QueryParameter> parameters;
+		benchmark::DoNotOptimize(predicate.Evaluate(parameters));
+	}
+}
+BENCHMARK(BM_ExpressionEvaluation);
+
+static void BM_Utf8RoundTrip(benchmark::State& state) {
+	const std::wstring text(state.range(0), L'α');
+	for (auto _ : state) {
+		const auto utf8 = StringUtilities::ToUtf8(text);
+		benchmark::DoNotOptimize(StringUtilities::FromUtf8(utf8.data()));
+	}
+	state.SetBytesProcessed(state.iterations() * state.range(0) * sizeof(wchar_t));
+}
+BENCHMARK(BM_Utf8RoundTrip)->Arg(8)->Arg(64)->Arg(4096);
+
+static void BM_IntRoundTrip(benchmark::State& state) {
+	int64_t value = 1234567890123;
+	for (auto _ : state) {
+		const auto text = StringUtilities::FromInt(value);
+		const auto wide_text = std::wstring(text.begin(), text.end());
+		benchmark::DoNotOptimize(StringUtilities::ToInt(wide_text));
+	}
+}
+BENCHMARK(BM_IntRoundTrip);
+
+static void BM_DoubleRoundTrip(benchmark::State& state) {
+	double value = 12345.678901;
+	for (auto _ : state) {
+		const auto text = StringUtilities::FromDouble(value);
+		const auto wide_text = std::wstring(text.begin(), text.end());
+		benchmark::DoNotOptimize(StringUtilities::ToDouble(wide_text));
+	}
+}
+BENCHMARK(BM_DoubleRoundTrip);
+
+static void BM_TimePointRoundTrip(benchmark::State& state) {
+	const TimePoint time_point(1600000000);
+	for (auto _ : state) {
+		const auto system_time = time_point.SystemTime();
+		benchmark::DoNotOptimize(TimePoint::FromSystemTime(system_time));
+	}
+}
+BENCHMARK(BM_TimePointRoundTrip);
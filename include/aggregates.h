@@ -0,0 +1,113 @@
+// MIT License
+//
+// Copyright (c) 2023 Ioannis Kaliakatsos
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include "reflection.h"
+
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace sqlite_reflection {
+	/// A wrapper of an aggregate function (for example SUM or COUNT) over the records of a group,
+	/// used to compute a typed value per group in grouped fetch queries. The value type is the
+	/// type in which the aggregate is returned, as an element of each group row
+	template <typename R>
+	struct AggregateExpression
+	{
+		typedef R value_type;
+
+		/// The textual representation of the aggregate, ready to be consumed by the SELECT query
+		std::string sql;
+
+		/// The storage class of the aggregate value
+		SqliteStorageClass storage_class;
+	};
+
+	/// Counts all records of a group
+	/// This corresponds to COUNT(*) in the SQL syntax
+	inline AggregateExpression<int64_t> Count() {
+		return {"COUNT(*)", SqliteStorageClass::kInt};
+	}
+
+	/// Sums a given integer member over all records of a group
+	/// This corresponds to SUM(member) in the SQL syntax
+	template <typename T>
+	AggregateExpression<int64_t> Sum(int64_t T::* fn) {
+		return {"SUM(" + GetMemberMetadata(fn).name + ")", SqliteStorageClass::kInt};
+	}
+
+	/// Sums a given real member over all records of a group
+	/// This corresponds to SUM(member) in the SQL syntax
+	template <typename T>
+	AggregateExpression<double> Sum(double T::* fn) {
+		return {"SUM(" + GetMemberMetadata(fn).name + ")", SqliteStorageClass::kReal};
+	}
+
+	/// Retrieves the minimum value of a given member over all records of a group
+	/// This corresponds to MIN(member) in the SQL syntax
+	template <typename T, typename R>
+	AggregateExpression<R> Min(R T::* fn) {
+		const auto& member = GetMemberMetadata(fn);
+		return {"MIN(" + member.name + ")", member.storage_class};
+	}
+
+	/// Retrieves the maximum value of a given member over all records of a group
+	/// This corresponds to MAX(member) in the SQL syntax
+	template <typename T, typename R>
+	AggregateExpression<R> Max(R T::* fn) {
+		const auto& member = GetMemberMetadata(fn);
+		return {"MAX(" + member.name + ")", member.storage_class};
+	}
+
+	/// Averages a given integer member over all records of a group
+	/// This corresponds to AVG(member) in the SQL syntax
+	template <typename T>
+	AggregateExpression<double> Avg(int64_t T::* fn) {
+		return {"AVG(" + GetMemberMetadata(fn).name + ")", SqliteStorageClass::kReal};
+	}
+
+	/// Averages a given real member over all records of a group
+	/// This corresponds to AVG(member) in the SQL syntax
+	template <typename T>
+	AggregateExpression<double> Avg(double T::* fn) {
+		return {"AVG(" + GetMemberMetadata(fn).name + ")", SqliteStorageClass::kReal};
+	}
+
+	/// Collects the type-erased addresses of the first N elements of a tuple, in order of appearance,
+	/// so that a grouped row can be populated in the same manner as the members of a record
+	template <size_t N, typename Tuple>
+	struct TupleElementAddresses
+	{
+		static void Collect(Tuple& tuple, std::vector<void*>& addresses) {
+			TupleElementAddresses<N - 1, Tuple>::Collect(tuple, addresses);
+			addresses.push_back((void*)&std::get<N - 1>(tuple));
+		}
+	};
+
+	template <typename Tuple>
+	struct TupleElementAddresses<0, Tuple>
+	{
+		static void Collect(Tuple&, std::vector<void*>&) {}
+	};
+}
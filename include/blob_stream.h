@@ -0,0 +1,128 @@
+// MIT License
+//
+// Copyright (c) 2023 Ioannis Kaliakatsos
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include "reflection_export.h"
+
+#include <cstdint>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+struct sqlite3;
+struct sqlite3_blob;
+
+namespace sqlite_reflection {
+	/// A handle for incremental I/O on the blob member of a single record, so that large payloads
+	/// can be read and written in chunks at given offsets, without loading them into memory at once.
+	/// The size of a blob cannot be changed through its handle, so space for a new payload needs to be
+	/// reserved first, with Database::ReserveBlob. The handle needs to be closed before the database
+	/// is finalized, which happens when it is destroyed
+	///
+	/// example:
+	/// db.ReserveBlob(&Attachment::content, id, file_size);
+	/// auto blob = db.OpenBlob(&Attachment::content, id, true);
+	/// blob.Write(chunk.data(), chunk.size(), offset);
+	class REFLECTION_EXPORT BlobHandle
+	{
+	public:
+		BlobHandle(sqlite3* db, const std::string& table, const std::string& column, int64_t id, bool writable);
+		~BlobHandle();
+
+		BlobHandle(BlobHandle&& other) noexcept;
+		BlobHandle& operator=(BlobHandle&& other) noexcept;
+
+		BlobHandle(BlobHandle const&) = delete;
+		void operator=(BlobHandle const&) = delete;
+
+		/// The size of the blob in bytes
+		size_t Size() const;
+
+		/// Whether the blob was opened for writing
+		bool Writable() const;
+
+		/// Reads up to the given number of bytes starting at the given offset into a buffer,
+		/// and returns the number of bytes read, which is smaller only at the end of the blob
+		size_t Read(void* buffer, size_t length, size_t offset) const;
+
+		/// Writes the given number of bytes at the given offset. Writing past the end of the blob is not possible
+		void Write(const void* data, size_t length, size_t offset);
+
+		/// Points the handle to the same member of another record, which is much faster than opening a new handle
+		void Reopen(int64_t id);
+
+		/// Closes the handle, after which no further operations are possible
+		void Close();
+
+	private:
+		sqlite3* db_;
+		sqlite3_blob* blob_;
+		bool writable_;
+	};
+
+	/// A stream buffer reading and writing a blob in chunks through a blob handle, which supports seeking,
+	/// so that a blob can be consumed by any standard stream, for example file << &buffer
+	class REFLECTION_EXPORT BlobStreamBuffer : public std::streambuf
+	{
+	public:
+		explicit BlobStreamBuffer(BlobHandle& blob, size_t chunk_size = 64 * 1024);
+		~BlobStreamBuffer() override;
+
+	protected:
+		int_type underflow() override;
+		int_type overflow(int_type c) override;
+		int sync() override;
+		std::streamsize showmanyc() override;
+		pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode mode) override;
+		pos_type seekpos(pos_type position, std::ios_base::openmode mode) override;
+
+	private:
+		/// The offset in the blob of the next byte to be read or written
+		size_t Position() const;
+
+		/// Writes all pending bytes of the put area to the blob. Returns false if they do not fit into the blob
+		bool Flush();
+
+		BlobHandle& blob_;
+		std::vector<char> buffer_;
+
+		/// The offset in the blob of the first byte of the buffer
+		size_t buffer_offset_;
+	};
+
+	/// An input and output stream over a blob
+	///
+	/// example:
+	/// auto blob = db.OpenBlob(&Attachment::content, id);
+	/// BlobStream stream(blob);
+	/// file << stream.rdbuf();
+	class REFLECTION_EXPORT BlobStream : public std::iostream
+	{
+	public:
+		explicit BlobStream(BlobHandle& blob, size_t chunk_size = 64 * 1024);
+
+	private:
+		BlobStreamBuffer buffer_;
+	};
+}
@@ -24,16 +24,47 @@
 
 #include <string>
 #include <vector>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <future>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 
 #include "reflection.h"
-#include "fetch_query_results.h"
 #include "query_predicates.h"
+#include "query_ordering.h"
+#include "aggregates.h"
 #include "queries.h"
+#include "query_statistics.h"
+#include "blob_stream.h"
 
 struct sqlite3;
 struct sqlite3_stmt;
 
 namespace sqlite_reflection {
+	template <typename T, typename K>
+	class GroupedFetch;
+
+	template <typename T>
+	class PreparedFetch;
+
+	/// Determines when the tables of all registered records are created or migrated
+	enum class REFLECTION_EXPORT TableCreation
+	{
+		/// All tables are created during initialization, in a single transaction
+		kEager,
+
+		/// Each table is created the first time its record type is used, which
+		/// shortens initialization when many record types are registered
+		kLazy
+	};
+
+	/// Reports the progress of a backup after each step, with the number of pages which remain to be copied,
+	/// and the total number of pages of the database
+	typedef std::function<void(int remaining_pages, int total_pages)> BackupProgress;
+
 	/// A wrapper of an SQLite database, enabling type-safe and compile-time CRUD operations,
 	/// encapsulating the C-based API of the underlying SQLite engine
 	class REFLECTION_EXPORT Database
@@ -43,7 +74,8 @@ namespace sqlite_reflection {
 		/// This function should be called before any operation is performed on the database.
 		/// During initialization all reflectable structs/records are registered and their corresponding tables are created in the database.
 		/// If the path is empty, an in-memory database is created.
-		static void Initialize(const std::string& path = "");
+		/// Tables are created either during initialization, or lazily the first time each record type is used
+		static void Initialize(const std::string& path = "", TableCreation table_creation = TableCreation::kEager);
 
 		/// This should, ideally,  be called before the program finishes execution, so that
 		/// the database connection is closed.
@@ -52,9 +84,29 @@ namespace sqlite_reflection {
 		/// Retrieves the database singleton wrapper for further operations
 		static const Database& Instance();
 
+		/// Opens an independent database at a given file path, which owns its connection, statement cache and
+		/// schema bootstrap, so that several database files can be used at the same time, for example as shards.
+		/// Records are registered and tables are created exactly as for the singleton.
+		/// If the path is empty, an in-memory database is created
+		explicit Database(const std::string& path, TableCreation table_creation = TableCreation::kEager);
+
+		/// Closes the database connection
+		~Database();
+
 		Database(Database const&) = delete;
 		void operator=(Database const&) = delete;
 
+		/// Takes over the connection of another database, which must not be used afterwards. Prepared fetches
+		/// created from the other database keep working, since they only refer to the connection, which is moved.
+		/// Moves never throw, so that databases can be kept in standard containers, which move them on reallocation
+		Database(Database&& other) noexcept;
+		Database& operator=(Database&& other) noexcept;
+
+		/// Creates an in-memory database from a snapshot of a given database file, for example a backup, so that
+		/// read-mostly replicas start with all records in memory. The file is only read, and the tables of all
+		/// records are then created or migrated in memory, exactly as for a database opened from a file
+		static Database LoadFromFile(const std::string& path, TableCreation table_creation = TableCreation::kEager);
+
 		/// Retrieves all entries of a given record from the database.
 		/// This corresponds to a SELECT query in the SQL syntax
 		template <typename T>
@@ -62,8 +114,7 @@ namespace sqlite_reflection {
 			const auto type_id = typeid(T).name();
 			const auto& record = GetRecord(type_id);
 			EmptyPredicate empty;
-			const auto& query_result = Fetch(record, &empty);
-			return Hydrate<T>(query_result, record);
+			return Fetch<T>(record, &empty, nullptr, -1);
 		}
 
 		/// Retrieves all entries of a given record from the database, which match a given predicate.
@@ -72,8 +123,62 @@ namespace sqlite_reflection {
 		std::vector<T> Fetch(const QueryPredicateBase* predicate) const {
 			const auto type_id = typeid(T).name();
 			const auto& record = GetRecord(type_id);
-			const auto& query_result = Fetch(record, predicate);
-			return Hydrate<T>(query_result, record);
+			return Fetch<T>(record, predicate, nullptr, -1);
+		}
+
+		/// Retrieves all entries of a given record from the database, sorted by a given ordering.
+		/// If a non-negative limit is given, only the first records up to this limit are retrieved.
+		/// This corresponds to a SELECT query with an ORDER BY and a LIMIT clause in the SQL syntax
+		template <typename T>
+		std::vector<T> FetchAll(const OrderBy& order_by, int64_t limit = -1) const {
+			EmptyPredicate empty;
+			return Fetch<T>(&empty, order_by, limit);
+		}
+
+		/// Retrieves all entries of a given record from the database, which match a given predicate,
+		/// sorted by a given ordering. If a non-negative limit is given, only the first records up to
+		/// this limit are retrieved, so that SQLite can avoid sorting the whole result set.
+		/// This corresponds to a SELECT query with an ORDER BY and a LIMIT clause in the SQL syntax
+		template <typename T>
+		std::vector<T> Fetch(const QueryPredicateBase* predicate, const OrderBy& order_by, int64_t limit = -1) const {
+			const auto type_id = typeid(T).name();
+			const auto& record = GetRecord(type_id);
+			return Fetch<T>(record, predicate, &order_by, limit);
+		}
+
+		/// Retrieves all entries of a given record from the database, whose full-text search member matches
+		/// a given FTS5 query, sorted by relevance. If a non-negative limit is given, only the best matching
+		/// records up to this limit are retrieved. The member needs to be declared with FTS_TEXT
+		template <typename T>
+		std::vector<T> Search(std::wstring T::* fn, const std::wstring& query, int64_t limit = -1) const {
+			const auto type_id = typeid(T).name();
+			const auto& record = GetRecord(type_id);
+			const auto& member = GetMemberMetadata(fn);
+			if (!member.full_text_search) {
+				throw std::invalid_argument("Member " + member.name + " of record " + record.name + " is not indexed for full-text search");
+			}
+			std::vector<T> models;
+			Search(record, member.name, QueryParameter::FromValue((void*)&query, SqliteStorageClass::kText), limit, NextRecord(models));
+			return models;
+		}
+
+		/// Prepares a fetch query for a given record type with a given predicate, which can be executed
+		/// repeatedly, rebinding new control values to the placeholders of the predicate in between.
+		/// The SQL statement is compiled only once, when the query is first executed
+		template <typename T>
+		PreparedFetch<T> PrepareFetch(const QueryPredicateBase* predicate) const {
+			const auto type_id = typeid(T).name();
+			const auto& record = GetRecord(type_id);
+			return PreparedFetch<T>(PrepareFetch(record, predicate, nullptr, -1));
+		}
+
+		/// Prepares a fetch query for a given record type with a given predicate, sorted by a given ordering
+		/// and restricted to a given limit, which can be executed repeatedly with new control values
+		template <typename T>
+		PreparedFetch<T> PrepareFetch(const QueryPredicateBase* predicate, const OrderBy& order_by, int64_t limit = -1) const {
+			const auto type_id = typeid(T).name();
+			const auto& record = GetRecord(type_id);
+			return PreparedFetch<T>(PrepareFetch(record, predicate, &order_by, limit));
 		}
 
 		/// Retrieves a single entry of a given record from the database, which matches a given id.
@@ -83,11 +188,56 @@ namespace sqlite_reflection {
 			const auto type_id = typeid(T).name();
 			const auto& record = GetRecord(type_id);
 			Equal equal_id_condition(&T::id, id);
-			const auto& query_result = Fetch(record, &equal_id_condition);
-			if (query_result.row_values.size() != 1) {
+			auto models = Fetch<T>(record, &equal_id_condition, nullptr, -1);
+			if (models.size() != 1) {
 				throw std::runtime_error("No record with this id found");
 			}
-			return Hydrate<T>(query_result, record)[0];
+			return models[0];
+		}
+
+		/// Retrieves all entries of a given record which match a given predicate, each together with all entries of a related
+		/// record, which refer to it through a MEMBER_REF member. The related entries are retrieved in a single query,
+		/// instead of one query per entry, and are sorted by their id
+		///
+		/// example:
+		/// // assume MEMBER_REF(Person, owner_id) in the FIELDS of Pet
+		/// const auto persons_with_pets = db.FetchWith<Person, Pet>(&predicate);
+		/// for (const auto& person_with_pets : persons_with_pets) {
+		///     // person_with_pets.first is a Person, person_with_pets.second are all pets with owner_id equal to its id
+		/// }
+		template <typename T, typename R>
+		std::vector<std::pair<T, std::vector<R>>> FetchWith(const QueryPredicateBase* predicate = nullptr) const {
+			const auto& related_record = GetRecord(typeid(R).name());
+			return FetchWith<T, R>(ReferenceMember(related_record, GetRecord(typeid(T).name())), predicate);
+		}
+
+		/// Same as above, for a related record with several members referring to the given record,
+		/// in which case the reference member is specified explicitly
+		template <typename T, typename R>
+		std::vector<std::pair<T, std::vector<R>>> FetchWith(int64_t R::* reference, const QueryPredicateBase* predicate = nullptr) const {
+			return FetchWith<T, R>(GetMemberMetadata(reference), predicate);
+		}
+
+		/// Retrieves all pairs of entries of two records, for which the given members are equal, optionally restricted
+		/// by a predicate on each record. Each pair is read directly from a single SQL JOIN, so that an index on
+		/// the member of the second record turns the join into a nested loop of index seeks
+		/// This corresponds to a SELECT ... JOIN ... ON query in the SQL syntax
+		///
+		/// example:
+		/// const auto adults = GreaterThanOrEqual(&Person::age, 18);
+		/// const auto persons_and_dogs = db.Join(&Person::id, &Dog::owner_id, &adults);
+		template <typename T, typename U, typename R>
+		std::vector<std::pair<T, U>> Join(R T::* fn, R U::* joined_fn, const QueryPredicateBase* predicate = nullptr,
+		                                  const QueryPredicateBase* joined_predicate = nullptr) const {
+			const auto& record = GetRecord(typeid(T).name());
+			const auto& joined_record = GetRecord(typeid(U).name());
+			std::vector<std::pair<T, U>> rows;
+			Join(record, GetMemberMetadata(fn).name, predicate, joined_record, GetMemberMetadata(joined_fn).name, joined_predicate,
+			     [&rows]() {
+				     rows.emplace_back();
+				     return std::make_pair((void*)&rows.back().first, (void*)&rows.back().second);
+			     });
+			return rows;
 		}
 
 		/// Retrieves the max id of a given record from the database
@@ -96,38 +246,164 @@ namespace sqlite_reflection {
 		int64_t GetMaxId() const {
 			const auto type_id = typeid(T).name();
 			const auto& record = GetRecord(type_id);
-			FetchMaxIdQuery query(db_, record);
-			const auto max_id = query.GetMaxId();
-			return max_id;
+			return GetMaxId(record);
 		}
         
+		/// Counts all entries of a given record in the database, which match a given predicate.
+		/// If no predicate is given, all entries are counted.
+		/// This corresponds to SELECT COUNT(*) FROM TABLE in the SQL syntax
+		template <typename T>
+		int64_t Count(const QueryPredicateBase* predicate = nullptr) const {
+			int64_t count = 0;
+			Aggregate<T>("COUNT(*)", predicate, &count, SqliteStorageClass::kInt);
+			return count;
+		}
+
+		/// Checks whether any entry of a given record in the database matches a given predicate, without
+		/// retrieving any entries. The evaluation stops as soon as the first matching entry is found.
+		/// If no predicate is given, it checks whether there is any entry at all.
+		/// This corresponds to SELECT EXISTS(SELECT 1 FROM TABLE WHERE ... LIMIT 1) in the SQL syntax
+		template <typename T>
+		bool Exists(const QueryPredicateBase* predicate = nullptr) const {
+			const auto type_id = typeid(T).name();
+			const auto& record = GetRecord(type_id);
+			return Exists(record, predicate);
+		}
+
+		/// Sums a given integer member over all entries of a given record in the database, which match a given predicate.
+		/// If no entries match, zero is returned.
+		/// This corresponds to SELECT SUM(member) FROM TABLE in the SQL syntax
+		template <typename T>
+		int64_t Sum(int64_t T::* fn, const QueryPredicateBase* predicate = nullptr) const {
+			int64_t sum = 0;
+			Aggregate<T>("SUM(" + GetMemberMetadata(fn).name + ")", predicate, &sum, SqliteStorageClass::kInt);
+			return sum;
+		}
+
+		/// Sums a given real member over all entries of a given record in the database, which match a given predicate.
+		/// If no entries match, zero is returned.
+		/// This corresponds to SELECT SUM(member) FROM TABLE in the SQL syntax
+		template <typename T>
+		double Sum(double T::* fn, const QueryPredicateBase* predicate = nullptr) const {
+			double sum = 0.0;
+			Aggregate<T>("SUM(" + GetMemberMetadata(fn).name + ")", predicate, &sum, SqliteStorageClass::kReal);
+			return sum;
+		}
+
+		/// Retrieves the minimum value of a given member over all entries of a given record in the database,
+		/// which match a given predicate. If no entries match, a default-constructed value is returned.
+		/// This corresponds to SELECT MIN(member) FROM TABLE in the SQL syntax
+		template <typename T, typename R>
+		R Min(R T::* fn, const QueryPredicateBase* predicate = nullptr) const {
+			const auto& member = GetMemberMetadata(fn);
+			R min = R();
+			Aggregate<T>("MIN(" + member.name + ")", predicate, &min, member.storage_class);
+			return min;
+		}
+
+		/// Retrieves the maximum value of a given member over all entries of a given record in the database,
+		/// which match a given predicate. If no entries match, a default-constructed value is returned.
+		/// This corresponds to SELECT MAX(member) FROM TABLE in the SQL syntax
+		template <typename T, typename R>
+		R Max(R T::* fn, const QueryPredicateBase* predicate = nullptr) const {
+			const auto& member = GetMemberMetadata(fn);
+			R max = R();
+			Aggregate<T>("MAX(" + member.name + ")", predicate, &max, member.storage_class);
+			return max;
+		}
+
+		/// Averages a given integer member over all entries of a given record in the database, which match a given predicate.
+		/// If no entries match, zero is returned.
+		/// This corresponds to SELECT AVG(member) FROM TABLE in the SQL syntax
+		template <typename T>
+		double Avg(int64_t T::* fn, const QueryPredicateBase* predicate = nullptr) const {
+			double average = 0.0;
+			Aggregate<T>("AVG(" + GetMemberMetadata(fn).name + ")", predicate, &average, SqliteStorageClass::kReal);
+			return average;
+		}
+
+		/// Averages a given real member over all entries of a given record in the database, which match a given predicate.
+		/// If no entries match, zero is returned.
+		/// This corresponds to SELECT AVG(member) FROM TABLE in the SQL syntax
+		template <typename T>
+		double Avg(double T::* fn, const QueryPredicateBase* predicate = nullptr) const {
+			double average = 0.0;
+			Aggregate<T>("AVG(" + GetMemberMetadata(fn).name + ")", predicate, &average, SqliteStorageClass::kReal);
+			return average;
+		}
+
+		/// Partitions all entries of a given record, which match a given predicate, into groups sharing the same value
+		/// of a given member. The aggregates per group are then specified through the returned object, for example
+		/// db.GroupBy(&Company::address).Aggregate(Sum(&Company::salary), Count())
+		/// The returned object refers to this database and the given predicate, so it can only be aggregated right away
+		/// This corresponds to a SELECT query with a GROUP BY clause in the SQL syntax
+		template <typename T, typename K>
+		GroupedFetch<T, K> GroupBy(K T::* fn, const QueryPredicateBase* predicate = nullptr) const {
+			return GroupedFetch<T, K>(*this, fn, predicate);
+		}
+
 		/// Saves a given record in the database.
 		/// This corresponds to an INSERT query in the SQL syntax
 		template <typename T>
 		void Save(const T& model) const {
-            Save(model, false);
+			const auto type_id = typeid(T).name();
+			const auto& record = GetRecord(type_id);
+			Save((void*)&model, record, false);
+		}
+
+		/// Saves a given record in the database, ignoring its id and letting SQLite assign the next available one,
+		/// which is returned. No extra query for the current max id is needed.
+		/// This corresponds to an INSERT ... RETURNING id query in the SQL syntax
+		template <typename T>
+		int64_t SaveAutoIncrement(const T& model) const {
+			const auto type_id = typeid(T).name();
+			const auto& record = GetRecord(type_id);
+			return Save((void*)&model, record, true);
+		}
+
+		/// Saves a given record in the database, letting SQLite assign the next available id,
+		/// which is written back to the record and returned
+		template <typename T>
+		int64_t SaveAutoIncrement(T& model) const {
+			model.id = SaveAutoIncrement(static_cast<const T&>(model));
+			return model.id;
 		}
-        
-        /// Saves a given record in the database and auto-increments its id.
-        /// This corresponds to an INSERT query in the SQL syntax
-        template <typename T>
-        void SaveAutoIncrement(const T& model) const {
-            Save(model, true);
-        }
 
 		/// Saves multiple records iteratively in the database.
 		/// This corresponds to an INSERT query in the SQL syntax
 		template <typename T>
 		void Save(const std::vector<T>& models) const {
-            Save(models, false);
+			const auto type_id = typeid(T).name();
+			const auto& record = GetRecord(type_id);
+			for (const auto& model : models) {
+				Save((void*)&model, record, false);
+			}
+		}
+
+		/// Saves multiple records iteratively in the database, letting SQLite assign the next available ids,
+		/// which are returned in the same order as the records
+		template <typename T>
+		std::vector<int64_t> SaveAutoIncrement(const std::vector<T>& models) const {
+			const auto type_id = typeid(T).name();
+			const auto& record = GetRecord(type_id);
+			std::vector<int64_t> ids;
+			ids.reserve(models.size());
+			for (const auto& model : models) {
+				ids.emplace_back(Save((void*)&model, record, true));
+			}
+			return ids;
+		}
+
+		/// Saves multiple records iteratively in the database, letting SQLite assign the next available ids,
+		/// which are written back to the records and returned in the same order as the records
+		template <typename T>
+		std::vector<int64_t> SaveAutoIncrement(std::vector<T>& models) const {
+			const auto ids = SaveAutoIncrement(static_cast<const std::vector<T>&>(models));
+			for (size_t i = 0; i < models.size(); ++i) {
+				models[i].id = ids[i];
+			}
+			return ids;
 		}
-        
-        /// Saves multiple records iteratively in the database and auto-increments their ids.
-        /// This corresponds to an INSERT query in the SQL syntax
-        template <typename T>
-        void SaveAutoIncrement(const std::vector<T>& models) const {
-            Save(models, true);
-        }
 
 		/// Updates a given record in the database.
 		/// This corresponds to an UPDATE query in the SQL syntax
@@ -178,67 +454,283 @@ namespace sqlite_reflection {
             Delete(record, predicate);
         }
         
+		/// Creates an index on a given member of a record type, if it does not exist yet, so that
+		/// equality, range and prefix predicates on this member become index seeks instead of table scans.
+		/// Case-insensitive indices serve LIKE predicates, for example StartsWith(&T::member, value, false)
+		template <typename T, typename R>
+		void CreateIndex(R T::* fn, bool case_insensitive = false) const {
+			const auto type_id = typeid(T).name();
+			const auto& record = GetRecord(type_id);
+			CreateIndex(record, GetMemberMetadata(fn).name, case_insensitive);
+		}
+
+		/// Opens a handle for incremental reading, and optionally writing, of the blob member of the record with the given id,
+		/// so that large payloads can be streamed in chunks at constant memory, for example through a BlobStream
+		template <typename T>
+		BlobHandle OpenBlob(std::vector<uint8_t> T::* fn, int64_t id, bool writable = false) const {
+			const auto type_id = typeid(T).name();
+			const auto& record = GetRecord(type_id);
+			return OpenBlob(record, GetMemberMetadata(fn).name, id, writable);
+		}
+
+		/// Replaces the blob member of the record with the given id with a zero-filled blob of the given size in bytes,
+		/// without allocating it in memory, so that its contents can then be written through a handle from OpenBlob
+		template <typename T>
+		void ReserveBlob(std::vector<uint8_t> T::* fn, int64_t id, size_t size) const {
+			const auto type_id = typeid(T).name();
+			const auto& record = GetRecord(type_id);
+			ReserveBlob(record, GetMemberMetadata(fn).name, id, size);
+		}
+
+		/// Copies the database to a given file while it remains in use, on a background thread. At most the given number
+		/// of pages is copied per step, and writers are blocked only during a single step. The optional progress callback
+		/// is invoked on the background thread after each step. If the database is modified during the backup, the modifications
+		/// are included in the backup. The returned future becomes ready when the backup is complete, and rethrows any error.
+		/// The database waits for all backups before it is closed. Databases in files are read through a separate read-only
+		/// connection, whereas in-memory databases are read through their own connection, which SQLite needs to serialize
+		/// for this (the default threading mode), otherwise an exception is thrown
+		///
+		/// example:
+		/// auto backup = db.BackupTo("snapshot.db", 256, [](int remaining, int total) { ... });
+		/// ...
+		/// backup.get();
+		std::shared_future<void> BackupTo(const std::string& path, int pages_per_step = 100, const BackupProgress& progress = nullptr) const;
+
+		/// Starts collecting latency histograms per record type and operation, together with the number of
+		/// retrieved records and bytes, and the latencies of all SQL statements. Statements which take longer
+		/// than the given threshold are logged with their SQL and query plan. Previously collected statistics
+		/// are discarded. This should not be called while other threads are performing queries
+		void EnableInstrumentation(double slow_query_threshold_milliseconds = 100.0) const;
+
+		/// Stops collecting statistics. Without instrumentation, operations perform no measurements at all
+		void DisableInstrumentation() const;
+
+		/// Returns a snapshot of the statistics collected since instrumentation was enabled,
+		/// or empty statistics if instrumentation is disabled
+		DatabaseStatistics Stats() const;
+
+		/// Returns the number of stored values of all compressed text members, together with their stored and uncompressed
+		/// sizes, from which the bytes saved by compression follow. Only the header of each value is read, but this still
+		/// scans the tables of all record types with compressed members, so it is not meant to be called frequently
+		CompressionStatistics CompressionStats() const;
+
+		/// Whether the text of compressed members is actually compressed, which requires the library to be built with zlib.
+		/// Otherwise such members are stored as plain UTF-8 text, and remain readable once zlib becomes available
+		static bool IsCompressionAvailable();
+
         /// Executes a raw SQL query. A trailing semicolon is added if needed
         void Sql(const std::string& raw_sql_query) const;
 
+		/// Executes a raw SQL query with the given values bound to its ? placeholders, in order of appearance,
+		/// and returns a cursor over its rows. Values can be of any type which can be bound to a prepared fetch
+		///
+		/// example:
+		/// auto cursor = db.Query("SELECT last_name, COUNT(*) FROM Person WHERE age >= ? GROUP BY last_name", 18);
+		/// while (cursor.Next()) {
+		///     const auto last_name = cursor.GetWideText(0);
+		///     const auto count = cursor.GetInt64(1);
+		/// }
+		template <typename... Args>
+		Cursor Query(const std::string& sql, const Args&... args) const {
+			std::vector<QueryParameter> parameters;
+			parameters.reserve(sizeof...(Args));
+			AppendParameters(parameters, args...);
+			return OpenCursor(sql, parameters);
+		}
+
+		/// Executes a raw SQL query with the given values bound to its ? placeholders, and reads each row into a
+		/// given record by matching the result columns to its members by name. Members without a column keep
+		/// their default values, so that partial or computed results can be read into records as well
+		///
+		/// example:
+		/// const auto persons = db.Query<Person>("SELECT * FROM Person WHERE age > ? ORDER BY age", 30);
+		template <typename T, typename... Args>
+		std::vector<T> Query(const std::string& sql, const Args&... args) const {
+			const auto& record = GetRecord(typeid(T).name());
+			std::vector<QueryParameter> parameters;
+			parameters.reserve(sizeof...(Args));
+			AppendParameters(parameters, args...);
+			std::vector<T> models;
+			Query(record, sql, parameters, NextRecord(models));
+			return models;
+		}
+
 	private:
-		explicit Database(const char* path);
+		/// Opens the database at a given path, optionally loading the contents of a snapshot file first
+		Database(const std::string& path, TableCreation table_creation, const std::string& snapshot_path);
+
+		/// Waits for all backups, and releases the connection and everything bound to it
+		void Close();
+
+		/// Creates the tables of the given records, or adds the columns of any new members to their existing tables,
+		/// in a single transaction. Tables which are up to date according to the schema snapshot are skipped
+		void Migrate(const std::vector<const Reflection*>& records, const SchemaSnapshot& snapshot) const;
+
+		/// Creates the table of a given record, or adds the columns of any new members to its existing table
+		void Migrate(const Reflection& record, const SchemaSnapshot& snapshot) const;
+
+		/// Makes sure that the table of a given record exists, before any query is performed on it.
+		/// This creates the table only for lazy table creation, the first time a record type is used
+		void EnsureTable(const Reflection& record) const;
 
-		/// Executes a fetch query (SELECT) for a given record with a given predicate,
-		/// and returns the results in a textual representation
-		FetchQueryResults Fetch(const Reflection& record, const QueryPredicateBase* predicate) const;
+		/// Retrieves the max id of a given record from the database
+		int64_t GetMaxId(const Reflection& record) const;
+
+		/// Executes a fetch query (SELECT) for a given record with a given predicate, sorted by a given ordering
+		/// and restricted to a given limit, and reads each resulting row into the record returned by the given callback
+		void Fetch(const Reflection& record, const QueryPredicateBase* predicate, const OrderBy* order_by, int64_t limit,
+		           const std::function<void*()>& next_record) const;
+
+		/// Executes a full-text search query for a given record and member, and reads each resulting row,
+		/// sorted by relevance, into the record returned by the given callback
+		void Search(const Reflection& record, const std::string& member_name, const QueryParameter& search_query, int64_t limit,
+		            const std::function<void*()>& next_record) const;
+
+		/// Executes a raw SQL query with the given bound values, and reads each resulting row into the record returned
+		/// by the given callback, after the table of the record has been created if needed
+		void Query(const Reflection& record, const std::string& sql, const std::vector<QueryParameter>& parameters,
+		           const std::function<void*()>& next_record) const;
+
+		/// Creates a re-executable fetch query for a given record with a given predicate, which owns its statement
+		std::unique_ptr<FetchRecordsQuery> PrepareFetch(const Reflection& record, const QueryPredicateBase* predicate, const OrderBy* order_by, int64_t limit) const;
 
 		/// Returns a record type from its type information, retrieved from typeid(...).name()
 		static const Reflection& GetRecord(const std::string& type_id);
 
-		/// Creates concrete record types with initialized members,
-		/// based on the textual representation of results from a fetch query
+		/// Executes a fetch query for a given record type, and creates concrete records with initialized members
 		template <typename T>
-		std::vector<T> Hydrate(const FetchQueryResults& query_results, const Reflection& record) const {
+		std::vector<T> Fetch(const Reflection& record, const QueryPredicateBase* predicate, const OrderBy* order_by, int64_t limit) const {
 			std::vector<T> models;
-			for (auto i = 0; i < query_results.row_values.size(); i++) {
-				T model;
-				FetchRecordsQuery::Hydrate((void*)&model, query_results, record, i);
-				models.emplace_back(model);
-			}
+			Fetch(record, predicate, order_by, limit, NextRecord(models));
 			return models;
 		}
+
+		/// Fetches the entries of a given record and their related entries, and groups the related entries by the entry they refer to
+		template <typename T, typename R>
+		std::vector<std::pair<T, std::vector<R>>> FetchWith(const Reflection::MemberMetadata& reference, const QueryPredicateBase* predicate) const {
+			const auto& record = GetRecord(typeid(T).name());
+			const auto& related_record = GetRecord(typeid(R).name());
+			const EmptyPredicate empty;
+			auto models = Fetch<T>(record, predicate != nullptr ? predicate : &empty, nullptr, -1);
+
+			std::vector<std::pair<T, std::vector<R>>> results;
+			results.reserve(models.size());
+			std::vector<int64_t> ids;
+			ids.reserve(models.size());
+			std::unordered_map<int64_t, size_t> positions;
+			for (auto& model : models) {
+				positions.emplace(model.id, results.size());
+				ids.push_back(model.id);
+				results.emplace_back(std::move(model), std::vector<R>());
+			}
+			if (ids.empty()) {
+				return results;
+			}
+
+			const In refers_to_ids(reference, ids);
+			const OrderBy by_id(&R::id);
+			auto related_models = Fetch<R>(related_record, &refers_to_ids, &by_id, -1);
+			for (auto& related_model : related_models) {
+				const auto referenced_id = *(int64_t*)((char*)&related_model + reference.offset);
+				const auto position = positions.find(referenced_id);
+				if (position != positions.end()) {
+					results[position->second].second.push_back(std::move(related_model));
+				}
+			}
+			return results;
+		}
+
+		/// Returns a callback, which appends a value-initialized record to the given records and returns
+		/// its address, so that the members of each fetched row are read in place
+		template <typename T>
+		static std::function<void*()> NextRecord(std::vector<T>& models) {
+			return [&models]() {
+				models.emplace_back();
+				return (void*)&models.back();
+			};
+		}
         
-        /// Saves a given record in the database.
-        /// This corresponds to an INSERT query in the SQL syntax
-        template <typename T>
-        void Save(const T& model, bool auto_increment_id) const {
-            const auto type_id = typeid(T).name();
-            const auto& record = GetRecord(type_id);
-            T saved_model(model);
-            if (auto_increment_id) {
-                const auto current_max_id = GetMaxId<T>();
-                saved_model.id = current_max_id + 1;
-            }
-            Save((void*)&saved_model, record);
-        }
-        
-        /// Saves multiple records iteratively in the database.
-        /// This corresponds to an INSERT query in the SQL syntax
-        template <typename T>
-        void Save(const std::vector<T>& models, bool auto_increment_id) const {
-            const auto type_id = typeid(T).name();
-            const auto& record = GetRecord(type_id);
-            const auto current_max_id = auto_increment_id ? GetMaxId<T>() : 0;
-            for (auto i = 0; i < models.size(); ++i) {
-                const auto& model = models[i];
-                if (auto_increment_id) {
-                    T saved_model(model);
-                    saved_model.id = current_max_id + i + 1;
-                    Save((void*)&saved_model, record);
-                } else {
-                    Save((void*)&model, record);
-                }
-            }
-        }
+		/// Executes an aggregate query for a given record type with a given predicate
+		template <typename T>
+		void Aggregate(const std::string& aggregate, const QueryPredicateBase* predicate, void* p, SqliteStorageClass storage_class) const {
+			const auto type_id = typeid(T).name();
+			const auto& record = GetRecord(type_id);
+			Aggregate(record, aggregate, predicate, p, storage_class);
+		}
+
+		/// Executes an aggregate query (for example SELECT COUNT(*)) for a given record with a given predicate,
+		/// and writes its result to a type-erased address, based on its concrete type
+		void Aggregate(const Reflection& record, const std::string& aggregate, const QueryPredicateBase* predicate, void* p, SqliteStorageClass storage_class) const;
+
+		/// Executes an existence query for a given record with a given predicate
+		bool Exists(const Reflection& record, const QueryPredicateBase* predicate) const;
+
+		/// Creates a cursor over the rows of a raw SQL query, bound to the given parameters
+		Cursor OpenCursor(const std::string& sql, const std::vector<QueryParameter>& parameters) const;
+
+		static void AppendParameters(std::vector<QueryParameter>&) {}
+
+		template <typename V, typename... Args>
+		static void AppendParameters(std::vector<QueryParameter>& parameters, const V& value, const Args&... args) {
+			parameters.push_back(Parameter(value));
+			AppendParameters(parameters, args...);
+		}
+
+		/// The conversions of the values of raw SQL queries to parameters, for all types of reflectable members
+		static QueryParameter Parameter(int64_t value) {
+			return QueryParameter::FromValue((void*)&value, SqliteStorageClass::kInt);
+		}
+
+		static QueryParameter Parameter(int value) {
+			return Parameter(static_cast<int64_t>(value));
+		}
 
-		/// Saves a single record in the database
-		void Save(void* p, const Reflection& record) const;
+		static QueryParameter Parameter(double value) {
+			return QueryParameter::FromValue((void*)&value, SqliteStorageClass::kReal);
+		}
+
+		static QueryParameter Parameter(bool value) {
+			return QueryParameter::FromValue((void*)&value, SqliteStorageClass::kBool);
+		}
+
+		static QueryParameter Parameter(const std::wstring& value) {
+			return QueryParameter::FromValue((void*)&value, SqliteStorageClass::kText);
+		}
+
+		static QueryParameter Parameter(const wchar_t* value) {
+			return Parameter(std::wstring(value));
+		}
+
+		static QueryParameter Parameter(const std::string& value) {
+			return QueryParameter::FromValue((void*)&value, SqliteStorageClass::kUtf8Text);
+		}
+
+		static QueryParameter Parameter(const char* value) {
+			return Parameter(std::string(value));
+		}
+
+		static QueryParameter Parameter(const TimePoint& value) {
+			return QueryParameter::FromValue((void*)&value, SqliteStorageClass::kDateTime);
+		}
+
+		static QueryParameter Parameter(const std::vector<uint8_t>& value) {
+			return QueryParameter::FromValue((void*)&value, SqliteStorageClass::kBlob);
+		}
+
+		/// Executes a join query for two given records and their given members, and reads each resulting row
+		/// into the pair of records returned by the given callback
+		void Join(const Reflection& record, const std::string& member_name, const QueryPredicateBase* predicate,
+		          const Reflection& joined_record, const std::string& joined_member_name, const QueryPredicateBase* joined_predicate,
+		          const std::function<std::pair<void*, void*>()>& next_row) const;
+
+		/// Executes a grouped fetch query (SELECT ... GROUP BY) for a given record with a given predicate,
+		/// and writes the group value and aggregates of each group to the type-erased addresses of a new row
+		void FetchGrouped(const Reflection& record, const std::string& group_column, const std::vector<std::string>& aggregates,
+		                  const QueryPredicateBase* predicate, const std::vector<SqliteStorageClass>& storage_classes,
+		                  const std::function<std::vector<void*>()>& next_row) const;
+
+		/// Saves a single record in the database and returns its id, which is assigned by SQLite for auto-incremented ids
+		int64_t Save(void* p, const Reflection& record, bool auto_increment_id) const;
 
 		/// Updates a single record in the database
 		void Update(void* p, const Reflection& record) const;
@@ -246,7 +738,161 @@ namespace sqlite_reflection {
 		/// Deletes a single record from the database
 		void Delete(const Reflection& record, const QueryPredicateBase* predicate) const;
 
+		/// Creates an index on a given column of a record table
+		void CreateIndex(const Reflection& record, const std::string& member_name, bool case_insensitive) const;
+
+		/// Opens a handle for incremental I/O on a given blob column of a single record
+		BlobHandle OpenBlob(const Reflection& record, const std::string& member_name, int64_t id, bool writable) const;
+
+		/// Replaces a given blob column of a single record with a zero-filled blob of the given size
+		void ReserveBlob(const Reflection& record, const std::string& member_name, int64_t id, size_t size) const;
+
+		template <typename T, typename K>
+		friend class GroupedFetch;
+
+		template <typename T>
+		friend class PreparedFetch;
+
 		static Database* instance_;
 		sqlite3* db_;
+
+		/// Compiled statements of fetch and aggregate queries, keyed by their SQL text
+		std::unique_ptr<StatementCache> statement_cache_;
+
+		/// The schema of the database at initialization, used for lazy table creation
+		SchemaSnapshot schema_snapshot_;
+
+		/// The records whose tables have been created or migrated so far, for lazy table creation
+		mutable std::unordered_set<const Reflection*> ready_tables_;
+		mutable std::mutex ready_tables_mutex_;
+
+		TableCreation table_creation_;
+
+		/// The statistics collector, which only exists while instrumentation is enabled
+		mutable std::unique_ptr<Instrumentation> instrumentation_;
+
+		/// The backups which have been started, and which may still be running
+		mutable std::vector<std::shared_future<void>> backups_;
+		mutable std::mutex backups_mutex_;
+	};
+
+	/// A fetch query for a given record type, which is compiled once and can then be executed
+	/// repeatedly, with new control values bound to the placeholders of its predicate in between
+	///
+	/// example:
+	/// Equal age(&Person::age, 0);
+	/// auto fetch = db.PrepareFetch<Person>(&age);
+	/// fetch.Bind(0, 30).Execute();
+	/// fetch.Bind(0, 40).Execute();
+	template <typename T>
+	class PreparedFetch
+	{
+	public:
+		/// Binds a new control value to the placeholder with the given index, in order of appearance in the predicate
+		PreparedFetch& Bind(size_t index, int64_t value) {
+			return Bind(index, (void*)&value, SqliteStorageClass::kInt);
+		}
+
+		PreparedFetch& Bind(size_t index, int value) {
+			return Bind(index, static_cast<int64_t>(value));
+		}
+
+		PreparedFetch& Bind(size_t index, double value) {
+			return Bind(index, (void*)&value, SqliteStorageClass::kReal);
+		}
+
+		PreparedFetch& Bind(size_t index, bool value) {
+			return Bind(index, (void*)&value, SqliteStorageClass::kBool);
+		}
+
+		PreparedFetch& Bind(size_t index, const std::wstring& value) {
+			return Bind(index, (void*)&value, SqliteStorageClass::kText);
+		}
+
+		PreparedFetch& Bind(size_t index, const wchar_t* value) {
+			return Bind(index, std::wstring(value));
+		}
+
+		PreparedFetch& Bind(size_t index, const std::string& value) {
+			return Bind(index, (void*)&value, SqliteStorageClass::kUtf8Text);
+		}
+
+		PreparedFetch& Bind(size_t index, const char* value) {
+			return Bind(index, std::string(value));
+		}
+
+		PreparedFetch& Bind(size_t index, const TimePoint& value) {
+			return Bind(index, (void*)&value, SqliteStorageClass::kDateTime);
+		}
+
+		PreparedFetch& Bind(size_t index, const std::vector<uint8_t>& value) {
+			return Bind(index, (void*)&value, SqliteStorageClass::kBlob);
+		}
+
+		/// Replaces all control values with the ones of the given predicate, which needs to have
+		/// the same shape (members, operators and number of values) as the prepared predicate
+		PreparedFetch& Bind(const QueryPredicateBase* predicate) {
+			query_->Bind(predicate);
+			return *this;
+		}
+
+		/// Executes the query with the currently bound control values
+		std::vector<T> Execute() {
+			std::vector<T> models;
+			query_->GetResults(Database::NextRecord(models));
+			return models;
+		}
+
+	private:
+		explicit PreparedFetch(std::unique_ptr<FetchRecordsQuery> query)
+			: query_(std::move(query)) {}
+
+		PreparedFetch& Bind(size_t index, void* value, SqliteStorageClass storage_class) {
+			query_->Bind(index, QueryParameter::FromValue(value, storage_class));
+			return *this;
+		}
+
+		friend class Database;
+
+		std::unique_ptr<FetchRecordsQuery> query_;
+	};
+
+	/// A grouped fetch query for a given record type, in which all records sharing the same value
+	/// of a given member form a group, for which a set of aggregates is computed inside SQLite.
+	/// It refers to the database it was created from, and can thus only be aggregated as a temporary,
+	/// in the same expression which creates it, so that it cannot outlive or miss a move of the database
+	template <typename T, typename K>
+	class GroupedFetch
+	{
+	public:
+		GroupedFetch(const Database& db, K T::* fn, const QueryPredicateBase* predicate)
+			: db_(db), fn_(fn), predicate_(predicate) {}
+
+		/// Returns one row per group, sorted by the group value. Each row holds the group value,
+		/// followed by the values of the given aggregates in the order they are passed
+		template <typename... A>
+		std::vector<std::tuple<K, typename A::value_type...>> Aggregate(const A&... aggregates) const && {
+			typedef std::tuple<K, typename A::value_type...> Row;
+			const auto type_id = typeid(T).name();
+			const auto& record = Database::GetRecord(type_id);
+			const auto& group_member = GetMemberMetadata(fn_);
+
+			const std::vector<std::string> aggregate_sql{aggregates.sql...};
+			const std::vector<SqliteStorageClass> storage_classes{group_member.storage_class, aggregates.storage_class...};
+
+			std::vector<Row> rows;
+			db_.FetchGrouped(record, group_member.name, aggregate_sql, predicate_, storage_classes, [&rows]() {
+				rows.emplace_back();
+				std::vector<void*> addresses;
+				TupleElementAddresses<std::tuple_size<Row>::value, Row>::Collect(rows.back(), addresses);
+				return addresses;
+			});
+			return rows;
+		}
+
+	private:
+		const Database& db_;
+		K T::* fn_;
+		const QueryPredicateBase* predicate_;
 	};
 }
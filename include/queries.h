@@ -24,14 +24,51 @@
 
 #include <string>
 #include <functional>
+#include <mutex>
+#include <set>
+#include <map>
+#include <unordered_map>
+#include <utility>
 
 #include "reflection.h"
 #include "query_predicates.h"
+#include "query_ordering.h"
+#include "query_statistics.h"
 
 struct sqlite3;
 struct sqlite3_stmt;
 
 namespace sqlite_reflection {
+	/// A cache of the prepared statements of a database connection, keyed by their SQL text, so that
+	/// queries of the same shape are parsed and planned only once. A cached statement is handed out
+	/// exclusively, so that it is never used by two queries at the same time
+	class REFLECTION_EXPORT StatementCache
+	{
+	public:
+		explicit StatementCache(sqlite3* db, size_t capacity = 256);
+		~StatementCache();
+
+		StatementCache(StatementCache const&) = delete;
+		void operator=(StatementCache const&) = delete;
+
+		/// Hands out a prepared statement for the given SQL text, which is either taken from the cache
+		/// or freshly prepared. Returns nullptr if the statement could not be prepared
+		sqlite3_stmt* Acquire(const std::string& sql);
+
+		/// Resets a statement retrieved from Acquire and keeps it for later reuse,
+		/// or finalizes it if the cache is already full
+		void Release(const std::string& sql, sqlite3_stmt* stmt);
+
+		/// Finalizes all cached statements
+		void Clear();
+
+	private:
+		sqlite3* db_;
+		size_t capacity_;
+		std::unordered_map<std::string, sqlite3_stmt*> statements_;
+		std::mutex mutex_;
+	};
+
 	/// A wrapper of all SQLite queries, encapsulating the preparation and
 	/// execution of queries against the SQLite database
 	class REFLECTION_EXPORT Query
@@ -40,7 +77,7 @@ namespace sqlite_reflection {
 		virtual ~Query() = default;
 
 	protected:
-		Query(sqlite3* db, const Reflection& record);
+		Query(sqlite3* db, const Reflection& record, StatementCache* cache = nullptr);
 
 		/// A textual representation of the given query, in SQL language
 		virtual std::string PrepareSql() const = 0;
@@ -55,8 +92,25 @@ namespace sqlite_reflection {
 		/// for marking the column corresponding to id as PRIMARY KEY
 		virtual std::string CustomizedColumnName(size_t index) const;
 
+		/// Returns the WHERE clause for a given predicate, in which all control values are replaced by ? placeholders
+		/// and appended to the given parameters, or an empty string if there is no predicate or the predicate is empty
+		static std::string WhereClause(const QueryPredicateBase* predicate, std::vector<QueryParameter>& parameters);
+
+		/// Returns a prepared statement for the given SQL text, which is taken from the statement cache
+		/// if one is available. Returns nullptr if the statement could not be prepared
+		sqlite3_stmt* AcquireStatement(const std::string& sql) const;
+
+		/// Hands a statement retrieved from AcquireStatement back to the statement cache,
+		/// or finalizes it if there is no statement cache
+		void ReleaseStatement(const std::string& sql, sqlite3_stmt* stmt) const;
+
+		/// Binds the given parameters to the ? placeholders of a prepared statement, in order of appearance.
+		/// The parameters need to outlive the evaluation of the statement, since textual values are not copied
+		static void BindParameters(sqlite3_stmt* stmt, const std::vector<QueryParameter>& parameters);
+
 		sqlite3* db_;
 		const Reflection& record_;
+		StatementCache* cache_;
 	};
 
 	/// A query for which no results are expected, such as
@@ -64,15 +118,20 @@ namespace sqlite_reflection {
 	/// UPDATE
 	/// INSERT
 	/// DELETE
+	/// The query runs in its own transaction, unless a transaction is already open on the connection,
+	/// in which case it becomes part of the open transaction
 	class REFLECTION_EXPORT ExecutionQuery : public Query
 	{
 	public:
 		~ExecutionQuery() override = default;
-		explicit ExecutionQuery(sqlite3* db, const Reflection& record);
+		explicit ExecutionQuery(sqlite3* db, const Reflection& record, StatementCache* cache = nullptr);
 		void Execute() const;
 
 	protected:
-		std::vector<std::string> GetValues(void* p) const;
+		/// Executes the query as a single prepared statement, binding the given members of a type-erased struct instance
+		/// to its ? placeholders in the given order. Text and blob members are bound without copying them.
+		/// Returns the integer in the first column of the first row, for statements with a RETURNING clause
+		int64_t Execute(void* p, const std::vector<size_t>& member_indices) const;
 	};
 
     /// A query for which direct SQL prompts are used
@@ -99,86 +158,401 @@ namespace sqlite_reflection {
 	protected:
 		std::string PrepareSql() const override;
 		std::string CustomizedColumnName(size_t index) const override;
+
+	};
+
+	/// A query for bringing an existing table of a given reflectable struct up to date with its current members.
+	/// Columns for newly added members are appended, while columns of removed members are kept untouched.
+	/// The full-text search index of the record is recreated and repopulated from the existing records
+	/// This maps to ALTER TABLE ... ADD COLUMN in SQL
+	class REFLECTION_EXPORT MigrateTableQuery final : public ExecutionQuery
+	{
+	public:
+		~MigrateTableQuery() override = default;
+		explicit MigrateTableQuery(sqlite3* db, const Reflection& record, const std::vector<std::string>& existing_columns);
+
+	protected:
+		std::string PrepareSql() const override;
+
+		std::vector<std::string> existing_columns_;
+	};
+
+	/// A query for retrieving the names of all columns of the table of a given reflectable struct,
+	/// as currently stored in the database. No columns are returned if the table does not exist
+	/// This maps to PRAGMA table_info in SQL
+	class REFLECTION_EXPORT TableColumnsQuery final : public Query
+	{
+	public:
+		explicit TableColumnsQuery(sqlite3* db, const Reflection& record);
+		~TableColumnsQuery() override;
+
+		std::vector<std::string> GetColumnNames();
+
+	protected:
+		std::string PrepareSql() const override;
+
+		sqlite3_stmt* stmt_;
+	};
+
+	/// The tables of a database and the schema hashes of all record tables, as recorded during their last migration
+	struct REFLECTION_EXPORT SchemaSnapshot
+	{
+		std::set<std::string> table_names;
+		std::map<std::string, uint64_t> schema_hashes;
+	};
+
+	/// A query for taking a snapshot of the schema of the whole database at once, so that
+	/// record tables which are up to date can be detected without any further queries
+	/// This maps to SELECT ... FROM sqlite_master in SQL
+	class REFLECTION_EXPORT SchemaSnapshotQuery final : public Query
+	{
+	public:
+		explicit SchemaSnapshotQuery(sqlite3* db);
+		~SchemaSnapshotQuery() override = default;
+
+		SchemaSnapshot GetSnapshot() const;
+
+	protected:
+		std::string PrepareSql() const override;
+	};
+
+	/// A query for recording the schema hash of a given reflectable struct, after its table has been created or migrated
+	class REFLECTION_EXPORT SaveSchemaHashQuery final : public ExecutionQuery
+	{
+	public:
+		~SaveSchemaHashQuery() override = default;
+		explicit SaveSchemaHashQuery(sqlite3* db, const Reflection& record, uint64_t hash);
+
+	protected:
+		std::string PrepareSql() const override;
+
+		uint64_t hash_;
+	};
+
+	/// A query to create an index on a given column of a record table, optionally with case-insensitive collation
+	/// This maps to CREATE INDEX in SQL
+	class REFLECTION_EXPORT CreateIndexQuery final : public ExecutionQuery
+	{
+	public:
+		~CreateIndexQuery() override = default;
+		explicit CreateIndexQuery(sqlite3* db, const Reflection& record, const std::string& member_name, bool case_insensitive);
+
+	protected:
+		std::string PrepareSql() const override;
+
+		std::string member_name_;
+		bool case_insensitive_;
+	};
+
+	/// A query to replace the blob member of a given record with a zero-filled blob of a given size,
+	/// so that its contents can then be written incrementally through a blob handle
+	/// This maps to UPDATE ... SET member = zeroblob(size) in SQL
+	class REFLECTION_EXPORT ReserveBlobQuery final : public ExecutionQuery
+	{
+	public:
+		~ReserveBlobQuery() override = default;
+		explicit ReserveBlobQuery(sqlite3* db, const Reflection& record, const std::string& member_name, int64_t id, size_t size);
+
+	protected:
+		std::string PrepareSql() const override;
+
+		std::string member_name_;
+		int64_t id_;
+		size_t size_;
+	};
+
+	/// A query for measuring the stored and uncompressed sizes of a compressed text member of all records,
+	/// which only reads the header of each stored value, instead of decompressing it
+	/// This maps to SELECT length(member), substr(member, 1, header size) FROM ... in SQL
+	class REFLECTION_EXPORT CompressionStatisticsQuery final : public Query
+	{
+	public:
+		~CompressionStatisticsQuery() override = default;
+		explicit CompressionStatisticsQuery(sqlite3* db, const Reflection& record, const std::string& member_name);
+
+		/// Adds the sizes of all stored values of the member to the given statistics
+		void Accumulate(CompressionStatistics& statistics) const;
+
+	protected:
+		std::string PrepareSql() const override;
+
+		std::string member_name_;
 	};
 
-	/// A query to delete a given record from the database, by means of its id
+	/// A query to delete the records which satisfy a given predicate from the database, where the control values
+	/// of the predicate are bound as parameters, so that its statement can be reused through the statement cache
 	/// This maps to DELETE in SQL
 	class REFLECTION_EXPORT DeleteQuery final : public ExecutionQuery
 	{
 	public:
 		~DeleteQuery() override = default;
-		explicit DeleteQuery(sqlite3* db, const Reflection& record, const QueryPredicateBase* predicate);
+		explicit DeleteQuery(sqlite3* db, const Reflection& record, const QueryPredicateBase* predicate, StatementCache* cache = nullptr);
+
+		void Delete() const;
 
 	protected:
 		std::string PrepareSql() const override;
-        const QueryPredicateBase* predicate_;
+
+		std::string where_clause_;
+		std::vector<QueryParameter> parameters_;
 	};
 
-	/// A query to insert a given record to the database, by supplying a given type-erased struct instance
-	/// This maps to INSERT INTO in SQL
+	/// A query to insert a given record to the database, by supplying a given type-erased struct instance.
+	/// For auto-incremented ids the id column is omitted, so that SQLite assigns the next available rowid
+	/// This maps to INSERT INTO ... RETURNING id in SQL
 	class REFLECTION_EXPORT InsertQuery final : public ExecutionQuery
 	{
 	public:
 		~InsertQuery() override = default;
-		explicit InsertQuery(sqlite3* db, const Reflection& record, void* p);
+		explicit InsertQuery(sqlite3* db, const Reflection& record, void* p, bool auto_increment_id = false, StatementCache* cache = nullptr);
+
+		/// Executes the insertion and returns the id of the inserted record
+		int64_t Insert() const;
 
 	protected:
 		std::string PrepareSql() const override;
-		std::string JoinedValues() const;
+
+		/// The indices of the inserted members, which are all members except for auto-incremented ids
+		std::vector<size_t> InsertedMembers() const;
+
 		void* p_;
+		bool auto_increment_id_;
 	};
 
 	/// A query to update a given record to the database, by supplying a given type-erased struct instance
-	/// This maps to UPDATE in SQL
+	/// This maps to UPDATE ... WHERE id = ? in SQL
 	class REFLECTION_EXPORT UpdateQuery final : public ExecutionQuery
 	{
 	public:
 		~UpdateQuery() override = default;
-		explicit UpdateQuery(sqlite3* db, const Reflection& record, void* p);
+		explicit UpdateQuery(sqlite3* db, const Reflection& record, void* p, StatementCache* cache = nullptr);
+
+		/// Executes the update of all members of the record with the same id
+		void Update() const;
 
 	protected:
 		std::string PrepareSql() const override;
 		void* p_;
 	};
 
+	/// A query for retrieving a single aggregate value (for example COUNT, SUM, MIN, MAX or AVG)
+	/// over all records of a given type from the database, which match a given predicate condition
+	/// This maps to SELECT <aggregate> FROM in SQL
+	class REFLECTION_EXPORT FetchAggregateQuery : public Query
+	{
+	public:
+		explicit FetchAggregateQuery(sqlite3* db, const Reflection& record, const std::string& aggregate, const QueryPredicateBase* predicate,
+		                             StatementCache* cache = nullptr);
+		~FetchAggregateQuery() override;
+
+		/// Writes the aggregate value to a type-erased address, based on its concrete type.
+		/// If the aggregate evaluates to NULL (for example the maximum over no records),
+		/// the value at the given address is left untouched
+		void GetResult(void* p, SqliteStorageClass storage_class);
+
+	protected:
+		std::string PrepareSql() const override;
+
+		sqlite3_stmt* stmt_;
+		std::string sql_;
+		std::string aggregate_;
+		std::string where_clause_;
+		std::vector<QueryParameter> parameters_;
+	};
+
 	/// A query for retrieving the max id of a given record from the database
-	class REFLECTION_EXPORT FetchMaxIdQuery final : public Query
+	class REFLECTION_EXPORT FetchMaxIdQuery final : public FetchAggregateQuery
 	{
 	public:
 		explicit FetchMaxIdQuery(sqlite3* db, const Reflection& record);
-		~FetchMaxIdQuery() override;
+		~FetchMaxIdQuery() override = default;
 
 		/// Retrieve the max id currently used for the given record type
 		int64_t GetMaxId();
+	};
+
+	/// A query for checking whether any record of a given type matches a given predicate condition,
+	/// which stops evaluating as soon as the first matching record is found
+	/// This maps to SELECT EXISTS(SELECT 1 ... LIMIT 1) in SQL
+	class REFLECTION_EXPORT ExistsQuery final : public FetchAggregateQuery
+	{
+	public:
+		explicit ExistsQuery(sqlite3* db, const Reflection& record, const QueryPredicateBase* predicate, StatementCache* cache = nullptr);
+		~ExistsQuery() override = default;
+
+		/// Returns true if at least one record matches the predicate condition
+		bool Exists();
 
 	protected:
 		std::string PrepareSql() const override;
-		sqlite3_stmt* stmt_;
 	};
 
-	struct FetchQueryResults;
+	/// A query for partitioning all records of a given type, which match a given predicate condition, into groups
+	/// sharing the same value of a given column, and retrieving a set of aggregate values for each group
+	/// This maps to SELECT ... GROUP BY in SQL
+	class REFLECTION_EXPORT FetchGroupedQuery final : public Query
+	{
+	public:
+		explicit FetchGroupedQuery(sqlite3* db, const Reflection& record, const std::string& group_column,
+		                           const std::vector<std::string>& aggregates, const QueryPredicateBase* predicate,
+		                           StatementCache* cache = nullptr);
+		~FetchGroupedQuery() override;
+
+		/// Steps through all groups, sorted by their group value. For each group, the type-erased addresses
+		/// of the group value followed by its aggregate values are requested from the given function,
+		/// and are then written based on the given storage classes
+		void GetResults(const std::vector<SqliteStorageClass>& storage_classes, const std::function<std::vector<void*>()>& next_row);
 
-	/// A query for retrieving all records from the database, which match a given predicate condition
-	/// This maps to SELECT * in SQL
-	class REFLECTION_EXPORT FetchRecordsQuery final : public Query
+	protected:
+		std::string PrepareSql() const override;
+
+		sqlite3_stmt* stmt_;
+		std::string sql_;
+		std::string group_column_;
+		std::vector<std::string> aggregates_;
+		std::string where_clause_;
+		std::vector<QueryParameter> parameters_;
+	};
+
+	/// A query for retrieving all records from the database, which match a given predicate condition,
+	/// optionally sorted by a given ordering and restricted to a maximum number of records
+	/// This maps to SELECT in SQL, with optional ORDER BY and LIMIT clauses. Columns are selected by name,
+	/// so that their order matches the member order, even for tables whose columns were added later
+	/// The statement is prepared only once, so that the query can be executed repeatedly,
+	/// with new control values bound to the placeholders of its predicate in between
+	class REFLECTION_EXPORT FetchRecordsQuery : public Query
 	{
 	public:
-		explicit FetchRecordsQuery(sqlite3* db, const Reflection& record, const QueryPredicateBase* predicate);
+		explicit FetchRecordsQuery(sqlite3* db, const Reflection& record, const QueryPredicateBase* predicate,
+		                           const OrderBy* order_by = nullptr, int64_t limit = -1, StatementCache* cache = nullptr);
 		~FetchRecordsQuery() override;
 
-		/// Returns a textual representation of the results of the query
-		FetchQueryResults GetResults();
+		/// Executes the query and reads each resulting row directly into the type-erased record returned by the given
+		/// callback, without any intermediate textual representation. Returns the number of read records.
+		/// If a byte counter is given, the size of all read values is added to it
+		size_t GetResults(const std::function<void*()>& next_record, uint64_t* bytes = nullptr);
+
+		/// Replaces the control value bound to the placeholder with the given index, in order of appearance in the predicate
+		void Bind(size_t index, const QueryParameter& parameter);
+
+		/// Replaces all control values with the ones of the given predicate, which needs
+		/// to have the same shape as the predicate this query was constructed with
+		void Bind(const QueryPredicateBase* predicate);
+
+	protected:
+		std::string PrepareSql() const override;
+
+		sqlite3_stmt* stmt_;
+		std::string sql_;
+		std::string where_clause_;
+		std::string order_by_clause_;
+
+		/// The maximum number of fetched records, where a negative value means no limit.
+		/// It is bound to the last placeholder, so that fetches differing only in their limit share one cached statement
+		int64_t limit_;
 
-		/// Reconstructs all record member values based on their concrete type,
-		/// based on the textual representation of the corresponding row result
-		/// of the fetch query
-		static void Hydrate(void* p, const FetchQueryResults& query_results, const Reflection& record, size_t i);
+		std::vector<QueryParameter> parameters_;
+	};
+
+	/// A query for retrieving all records from the database, whose full-text search member matches
+	/// a given FTS5 query, sorted by relevance and optionally restricted to a maximum number of records
+	/// This maps to SELECT ... MATCH ... ORDER BY rank in SQL
+	class REFLECTION_EXPORT SearchRecordsQuery final : public FetchRecordsQuery
+	{
+	public:
+		explicit SearchRecordsQuery(sqlite3* db, const Reflection& record, const std::string& member_name,
+		                            const QueryParameter& search_query, int64_t limit = -1, StatementCache* cache = nullptr);
+		~SearchRecordsQuery() override = default;
 
 	protected:
 		std::string PrepareSql() const override;
-		std::wstring GetColumnValue(int col) const;
 
+		std::string member_name_;
+	};
+
+	/// A query for retrieving the records of two types, whose given members are equal, with optional predicates on each
+	/// record type. Predicates are applied to each table before joining, so that their member names are not ambiguous
+	/// This maps to SELECT ... FROM (SELECT * FROM A WHERE ...) AS lhs JOIN (SELECT * FROM B WHERE ...) AS rhs ON lhs.a = rhs.b in SQL
+	class REFLECTION_EXPORT JoinRecordsQuery final : public Query
+	{
+	public:
+		explicit JoinRecordsQuery(sqlite3* db, const Reflection& record, const std::string& member_name, const QueryPredicateBase* predicate,
+		                          const Reflection& joined_record, const std::string& joined_member_name, const QueryPredicateBase* joined_predicate,
+		                          StatementCache* cache = nullptr);
+		~JoinRecordsQuery() override = default;
+
+		/// Executes the query and reads each resulting row directly into the pair of type-erased records returned
+		/// by the given callback. Returns the number of read rows
+		size_t GetResults(const std::function<std::pair<void*, void*>()>& next_row) const;
+
+	protected:
+		std::string PrepareSql() const override;
+
+		std::string member_name_;
+		std::string where_clause_;
+		const Reflection& joined_record_;
+		std::string joined_member_name_;
+		std::string joined_where_clause_;
+		std::vector<QueryParameter> parameters_;
+	};
+
+	/// A forward-only cursor over the rows of a raw SQL query, whose parameters are bound to its ? placeholders.
+	/// The values of the current row are read either by column index, or into a reflectable struct by column name.
+	/// The cursor owns its statement until it is destroyed, at which point the statement is handed back to the
+	/// statement cache, so it should not outlive the database it was created from
+	///
+	/// example:
+	/// auto cursor = db.Query("SELECT last_name, AVG(age) FROM Person WHERE age > ? GROUP BY last_name", 18);
+	/// while (cursor.Next()) {
+	///     std::cout << cursor.GetText(0) << ": " << cursor.GetDouble(1) << std::endl;
+	/// }
+	class REFLECTION_EXPORT Cursor final : public Query
+	{
+	public:
+		explicit Cursor(sqlite3* db, const std::string& sql, const std::vector<QueryParameter>& parameters, StatementCache* cache = nullptr);
+		~Cursor() override;
+
+		Cursor(Cursor&& other) noexcept;
+		Cursor& operator=(Cursor&& other) noexcept;
+		Cursor(const Cursor&) = delete;
+		void operator=(const Cursor&) = delete;
+
+		/// Advances to the next row, and returns false once all rows have been read
+		bool Next();
+
+		int ColumnCount() const;
+		std::string ColumnName(int col) const;
+
+		/// Whether the value of the given column of the current row is NULL
+		bool IsNull(int col) const;
+
+		int64_t GetInt64(int col) const;
+		double GetDouble(int col) const;
+
+		/// Returns the value of the given column as UTF-8 text
+		std::string GetText(int col) const;
+
+		/// Returns the value of the given column as wide text, the same way as for MEMBER_TEXT members
+		std::wstring GetWideText(int col) const;
+
+		std::vector<uint8_t> GetBlob(int col) const;
+
+		/// Reads the current row into a type-erased reflectable struct, by matching the names of the result columns
+		/// to its member names. Columns without a matching member are ignored, and members without a matching column
+		/// keep their values
+		void Read(void* p, const Reflection& record);
+
+	protected:
+		std::string PrepareSql() const override;
+
+		std::string sql_;
+
+		/// The bound values, which are kept alive until the statement is released, since textual values are not copied
+		std::vector<QueryParameter> parameters_;
 		sqlite3_stmt* stmt_;
-		const QueryPredicateBase* predicate_;
+
+		/// The record and member index of each result column, resolved on the first Read
+		const Reflection* read_record_;
+		std::vector<int> read_members_;
 	};
 }
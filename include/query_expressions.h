@@ -0,0 +1,201 @@
+// MIT License
+//
+// Copyright (c) 2023 Ioannis Kaliakatsos
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include "query_predicates.h"
+
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace sqlite_reflection {
+	/// The comparison and logical operators of predicate expressions, whose SQL symbols are compile-time constants
+	struct EqualOperator { static const char* Symbol() { return " = "; } };
+	struct UnequalOperator { static const char* Symbol() { return " != "; } };
+	struct GreaterThanOperator { static const char* Symbol() { return " > "; } };
+	struct GreaterThanOrEqualOperator { static const char* Symbol() { return " >= "; } };
+	struct SmallerThanOperator { static const char* Symbol() { return " < "; } };
+	struct SmallerThanOrEqualOperator { static const char* Symbol() { return " <= "; } };
+	struct AndOperator { static const char* Symbol() { return " AND "; } };
+	struct OrOperator { static const char* Symbol() { return " OR "; } };
+
+	/// The base of all predicate expressions, which are built with C++ operators instead of predicate objects.
+	/// Expressions are plain values, in which each node holds its children by value, and their evaluation is
+	/// dispatched at compile time through the concrete type of each node, without any virtual calls between nodes.
+	/// Since all control values are bound as parameters, expressions over the same members and operators produce
+	/// the same SQL text, and thus share the same compiled statement in the statement cache
+	///
+	/// example:
+	/// const auto predicate = col(&Person::age) > 30 && col(&Person::first_name) == L"john";
+	/// db.Fetch<Person>(&predicate);
+	template <typename E>
+	class Expression : public QueryPredicateBase
+	{
+	public:
+		std::string Evaluate() const override {
+			std::string sql;
+			static_cast<const E&>(*this).Append(sql, nullptr);
+			return sql;
+		}
+
+		std::string Evaluate(std::vector<QueryParameter>& parameters) const override {
+			parameters.reserve(parameters.size() + E::parameter_count);
+			std::string sql;
+			static_cast<const E&>(*this).Append(sql, &parameters);
+			return sql;
+		}
+
+		QueryPredicateBase* Clone() const override {
+			return new E(static_cast<const E&>(*this));
+		}
+	};
+
+	/// A comparison of a struct member with a given control value
+	template <typename R, typename Op>
+	class ComparisonExpression final : public Expression<ComparisonExpression<R, Op>>
+	{
+	public:
+		static const size_t parameter_count = 1;
+
+		ComparisonExpression(const Reflection::MemberMetadata& member, const R& value)
+			: member_(&member), value_(value) {}
+
+		/// Appends the textual representation of the comparison to the given SQL. If parameters are given,
+		/// the control value is appended to them and replaced by a ? placeholder, otherwise it is embedded as a literal
+		void Append(std::string& sql, std::vector<QueryParameter>* parameters) const {
+			const auto parameter = QueryParameter::FromValue((void*)&value_, member_->storage_class);
+			sql += member_->name;
+			sql += Op::Symbol();
+			if (parameters != nullptr) {
+				parameters->emplace_back(parameter);
+				sql += '?';
+			} else {
+				sql += parameter.ToSql();
+			}
+		}
+
+	private:
+		const Reflection::MemberMetadata* member_;
+		R value_;
+	};
+
+	/// A logical combination of two expressions
+	template <typename L, typename R, typename Op>
+	class CompoundExpression final : public Expression<CompoundExpression<L, R, Op>>
+	{
+	public:
+		static const size_t parameter_count = L::parameter_count + R::parameter_count;
+
+		CompoundExpression(const L& left, const R& right)
+			: left_(left), right_(right) {}
+
+		/// Appends the textual representation of both expressions, enclosed in parentheses, to the given SQL
+		void Append(std::string& sql, std::vector<QueryParameter>* parameters) const {
+			sql += '(';
+			left_.Append(sql, parameters);
+			sql += Op::Symbol();
+			right_.Append(sql, parameters);
+			sql += ')';
+		}
+
+	private:
+		L left_;
+		R right_;
+	};
+
+	/// Detects whether values of type V can be converted to type R by list-initialization, which rejects narrowing
+	/// conversions such as from floating point to integral types
+	template <typename V, typename R, typename = void>
+	struct IsNonNarrowingConversion : std::false_type {};
+
+	template <typename V, typename R>
+	struct IsNonNarrowingConversion<V, R, decltype(void(R{std::declval<const V&>()}))> : std::true_type {};
+
+	/// A reference to a struct member, which is compared with control values to build predicate expressions
+	template <typename T, typename R>
+	class Column
+	{
+	public:
+		explicit Column(R T::* fn)
+			: member_(&GetMemberMetadata(fn)) {}
+
+		/// Compares the member with a control value, which must be convertible to the member type without narrowing,
+		/// so that for example col(&Person::age) == 30.7 does not compile, instead of silently matching an age of 30
+		template <typename Op, typename V>
+		ComparisonExpression<R, Op> Compare(const V& value) const {
+			static_assert(IsNonNarrowingConversion<V, R>::value,
+			              "The control value cannot be converted to the member type without narrowing");
+			return ComparisonExpression<R, Op>(*member_, R(value));
+		}
+
+	private:
+		const Reflection::MemberMetadata* member_;
+	};
+
+	/// Creates a reference to a struct member for predicate expressions, for example col(&Person::age) > 30
+	template <typename T, typename R>
+	Column<T, R> col(R T::* fn) {
+		return Column<T, R>(fn);
+	}
+
+	template <typename T, typename R, typename V>
+	ComparisonExpression<R, EqualOperator> operator==(const Column<T, R>& column, const V& value) {
+		return column.template Compare<EqualOperator>(value);
+	}
+
+	template <typename T, typename R, typename V>
+	ComparisonExpression<R, UnequalOperator> operator!=(const Column<T, R>& column, const V& value) {
+		return column.template Compare<UnequalOperator>(value);
+	}
+
+	template <typename T, typename R, typename V>
+	ComparisonExpression<R, GreaterThanOperator> operator>(const Column<T, R>& column, const V& value) {
+		return column.template Compare<GreaterThanOperator>(value);
+	}
+
+	template <typename T, typename R, typename V>
+	ComparisonExpression<R, GreaterThanOrEqualOperator> operator>=(const Column<T, R>& column, const V& value) {
+		return column.template Compare<GreaterThanOrEqualOperator>(value);
+	}
+
+	template <typename T, typename R, typename V>
+	ComparisonExpression<R, SmallerThanOperator> operator<(const Column<T, R>& column, const V& value) {
+		return column.template Compare<SmallerThanOperator>(value);
+	}
+
+	template <typename T, typename R, typename V>
+	ComparisonExpression<R, SmallerThanOrEqualOperator> operator<=(const Column<T, R>& column, const V& value) {
+		return column.template Compare<SmallerThanOrEqualOperator>(value);
+	}
+
+	template <typename L, typename R>
+	CompoundExpression<L, R, AndOperator> operator&&(const Expression<L>& left, const Expression<R>& right) {
+		return CompoundExpression<L, R, AndOperator>(static_cast<const L&>(left), static_cast<const R&>(right));
+	}
+
+	template <typename L, typename R>
+	CompoundExpression<L, R, OrOperator> operator||(const Expression<L>& left, const Expression<R>& right) {
+		return CompoundExpression<L, R, OrOperator>(static_cast<const L&>(left), static_cast<const R&>(right));
+	}
+}
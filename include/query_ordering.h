@@ -0,0 +1,68 @@
+// MIT License
+//
+// Copyright (c) 2023 Ioannis Kaliakatsos
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include "reflection.h"
+
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace sqlite_reflection {
+	/// The direction in which fetched records are sorted for a given struct member
+	enum class REFLECTION_EXPORT Direction
+	{
+		kAscending,
+		kDescending
+	};
+
+	/// A wrapper of the sorting applied to the results of a fetch query, which can be constructed from
+	/// a pointer-to-member function of a reflectable struct, thus enabling type safety and compile-time
+	/// guarantees, that the ordering is indeed valid
+	class REFLECTION_EXPORT OrderBy
+	{
+	public:
+		template <typename T, typename R>
+		explicit OrderBy(R T::* fn, Direction direction = Direction::kAscending) {
+			Append(GetMemberMetadata(fn).name, direction);
+		}
+
+		/// Returns a compound ordering, in which records which are equivalent according to
+		/// the current ordering are further sorted by the given struct member
+		template <typename T, typename R>
+		OrderBy ThenBy(R T::* fn, Direction direction = Direction::kAscending) const {
+			OrderBy ordering(*this);
+			ordering.Append(GetMemberMetadata(fn).name, direction);
+			return ordering;
+		}
+
+		/// Returns a textual representation of the ordering, ready to be consumed by the SELECT query
+		std::string Evaluate() const;
+
+	private:
+		void Append(const std::string& member_name, Direction direction);
+
+		/// The names of the sorted members, in order of decreasing priority, along with their sorting direction
+		std::vector<std::pair<std::string, Direction>> terms_;
+	};
+}
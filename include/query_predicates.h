@@ -25,12 +25,43 @@
 #include "reflection.h"
 
 #include <string>
+#include <vector>
 #include <memory>
 
 namespace sqlite_reflection {
 	class AndPredicate;
 	class OrPredicate;
 
+	/// A type-erased value, which is bound to a ? placeholder of a prepared SQLite statement,
+	/// so that the value itself does not need to be embedded in the SQL text
+	struct REFLECTION_EXPORT QueryParameter
+	{
+		/// Creates a parameter from a type-erased value, based on its storage class
+		static QueryParameter FromValue(void* v, SqliteStorageClass storage_class);
+
+		/// Creates a textual parameter from a UTF-8 encoded string
+		static QueryParameter FromText(const std::string& utf8_text);
+
+		/// Returns the value of this parameter as an SQL literal, with text values
+		/// enclosed in single quotes, for example 'john', and blobs as hexadecimal literals, for example X'0AFF'
+		std::string ToSql() const;
+
+		/// Returns the value of this parameter as plain text, without any quotes
+		std::string ToText() const;
+
+		/// The storage class of the value, which determines how the value is bound
+		SqliteStorageClass storage_class;
+
+		/// The value for integer and boolean storage classes
+		int64_t int_value;
+
+		/// The value for the real storage class
+		double real_value;
+
+		/// The UTF-8 encoded value for text and datetime storage classes, or the raw bytes for blobs and packed arrays
+		std::string text_value;
+	};
+
 	/// The base class of all WHERE predicates used in SQLite queries
 	class REFLECTION_EXPORT QueryPredicateBase
 	{
@@ -40,6 +71,11 @@ namespace sqlite_reflection {
 		/// Returns a textual representation of the predicate, ready to be consumed by the SELECT query
 		virtual std::string Evaluate() const = 0;
 
+		/// Returns a textual representation of the predicate, in which all control values are replaced by ? placeholders,
+		/// while the values themselves are appended to the given parameters in order of appearance. Predicates of the same
+		/// shape evaluate to the same text, so that a prepared statement can be reused for different control values
+		virtual std::string Evaluate(std::vector<QueryParameter>& parameters) const = 0;
+
 		/// Creates a clone for compounding predicates
 		virtual QueryPredicateBase* Clone() const = 0;
 
@@ -59,37 +95,19 @@ namespace sqlite_reflection {
 	{
 	public:
 		std::string Evaluate() const override;
+		std::string Evaluate(std::vector<QueryParameter>& parameters) const override;
 		QueryPredicateBase* Clone() const override;
 
 	protected:
-		template <typename T, typename R>
-		QueryPredicate(R T::* fn, R value, const std::string& symbol, std::function<std::string(void*, SqliteStorageClass)> value_retrieval)
-		: symbol_(symbol)
-		{
-			auto record = GetRecordFromTypeId(typeid(T).name());
-			auto offset = OffsetFromStart(fn);
-			for (auto i = 0; i < record.member_metadata.size(); ++i) {
-				if (record.member_metadata[i].offset == offset) {
-					member_name_ = record.member_metadata[i].name;
-					value_ = value_retrieval((void*)&value, record.member_metadata[i].storage_class);
-					break;
-				}
-			}
-		}
-
 		template <typename T, typename R>
 		QueryPredicate(R T::* fn, R value, const std::string& symbol)
-			: QueryPredicate(fn, value, symbol, [&](void* v, SqliteStorageClass storage_class){
-				return GetStringForValue(v, storage_class);
-			}) {}
+			: QueryPredicate(symbol,
+			                 GetMemberMetadata(fn).name,
+			                 "?",
+			                 std::vector<QueryParameter>{QueryParameter::FromValue((void*)&value, GetMemberMetadata(fn).storage_class)}) {}
 
-		QueryPredicate(const std::string& symbol, const std::string& member_name, const std::string& value)
-			: symbol_(symbol), member_name_(member_name), value_(value) {}
-
-		/// Returns a textual representation of the value used for the current query, against which the
-		/// struct member (defined from the pointer-to-member function) will be compared. The value needs
-		/// to be type-erased, so that the header file is not bloated with unnecessary implementation details
-		virtual std::string GetStringForValue(void* v, SqliteStorageClass storage_class) const;
+		QueryPredicate(const std::string& symbol, const std::string& member_name, const std::string& placeholder, const std::vector<QueryParameter>& parameters)
+			: symbol_(symbol), member_name_(member_name), placeholder_(placeholder), parameters_(parameters) {}
 
 		/// The symbol used for the comparison, for example "=" for equality
 		std::string symbol_;
@@ -98,9 +116,12 @@ namespace sqlite_reflection {
 		/// textual representation of the evaluation string
 		std::string member_name_;
 
-		/// The textual representation of the comparison value, used to construct the
-		/// textual representation of the evaluation string
-		std::string value_;
+		/// The textual representation of the comparison value, in which each control value is
+		/// replaced by a ? placeholder, for example "?" or "(?, ?, ?)"
+		std::string placeholder_;
+
+		/// The control values, in the order of their placeholders
+		std::vector<QueryParameter> parameters_;
 	};
 
 	/// A wrapper for an empty predicate, used to fetch all elements of an SQLite table
@@ -108,6 +129,7 @@ namespace sqlite_reflection {
 	{
 	public:
 		std::string Evaluate() const override;
+		std::string Evaluate(std::vector<QueryParameter>& parameters) const override;
 		QueryPredicateBase* Clone() const override;
 	};
 
@@ -127,6 +149,10 @@ namespace sqlite_reflection {
         template <typename T>
         explicit Equal(std::wstring T::* fn, const wchar_t* value)
         : Equal(fn, std::wstring(value)) {}
+
+        template <typename T>
+        explicit Equal(std::string T::* fn, const char* value)
+        : Equal(fn, std::string(value)) {}
 	};
 
 	/// A wrapper for an inequality predicate, for which the value of the
@@ -145,6 +171,10 @@ namespace sqlite_reflection {
         template <typename T>
         explicit Unequal(std::wstring T::* fn, const wchar_t* value)
         : Unequal(fn, std::wstring(value)) {}
+
+        template <typename T>
+        explicit Unequal(std::string T::* fn, const char* value)
+        : Unequal(fn, std::string(value)) {}
 	};
 
 	/// A wrapper for a similarity predicate, for which the value of the
@@ -154,9 +184,10 @@ namespace sqlite_reflection {
 	public:
 		template <typename T, typename R>
 		explicit Like(R T::* fn, R value)
-			: QueryPredicate(fn, value, "LIKE", [&](void* v, SqliteStorageClass storage_class){
-				return GetStringForValue(v, storage_class);
-			}) {}
+			: QueryPredicate("LIKE",
+			                 GetMemberMetadata(fn).name,
+			                 "?",
+			                 std::vector<QueryParameter>{Pattern(QueryParameter::FromValue((void*)&value, GetMemberMetadata(fn).storage_class))}) {}
         
         template <typename T>
         explicit Like(int64_t T::* fn, int value)
@@ -166,9 +197,133 @@ namespace sqlite_reflection {
         explicit Like(std::wstring T::* fn, const wchar_t* value)
         : Like(fn, std::wstring(value)) {}
 
+        template <typename T>
+        explicit Like(std::string T::* fn, const char* value)
+        : Like(fn, std::string(value)) {}
+
 	protected:
-		std::string GetStringForValue(void* v, SqliteStorageClass storage_class) const override;
-		static std::string Remove(const std::string& source, const std::string& substring);
+		/// Returns a textual parameter, which matches any text containing the given value. Values of members which are
+		/// stored as binary blobs, including compressed text, cannot be matched this way, and are rejected
+		static QueryParameter Pattern(const QueryParameter& value);
+	};
+
+	/// The base of all text pattern predicates. Case-sensitive patterns are evaluated with GLOB,
+	/// case-insensitive ones with LIKE, and any wildcard characters of the control value are escaped,
+	/// so that the value is always matched literally
+	class REFLECTION_EXPORT TextPattern : public QueryPredicate
+	{
+	protected:
+		TextPattern(const std::string& member_name, const std::wstring& value, bool case_sensitive, bool any_prefix, bool any_suffix)
+			: QueryPredicate(case_sensitive ? "GLOB" : "LIKE",
+			                 member_name,
+			                 case_sensitive ? "?" : "? ESCAPE '\\'",
+			                 std::vector<QueryParameter>{Pattern(value, case_sensitive, any_prefix, any_suffix)}) {}
+
+		TextPattern(const std::string& member_name, const std::string& utf8_value, bool case_sensitive, bool any_prefix, bool any_suffix)
+			: QueryPredicate(case_sensitive ? "GLOB" : "LIKE",
+			                 member_name,
+			                 case_sensitive ? "?" : "? ESCAPE '\\'",
+			                 std::vector<QueryParameter>{Pattern(utf8_value, case_sensitive, any_prefix, any_suffix)}) {}
+
+		TextPattern(const std::string& symbol, const std::string& member_name, const std::string& placeholder, const std::vector<QueryParameter>& parameters)
+			: QueryPredicate(symbol, member_name, placeholder, parameters) {}
+
+		/// Returns the name of a member which is matched against a text pattern. Compressed text members are rejected,
+		/// since their values are stored as compressed blobs, against which patterns cannot be matched
+		static const std::string& PatternMemberName(const Reflection::MemberMetadata& member);
+
+		/// Returns a textual parameter with the escaped value, optionally enclosed in wildcards
+		static QueryParameter Pattern(const std::wstring& value, bool case_sensitive, bool any_prefix, bool any_suffix);
+		static QueryParameter Pattern(const std::string& utf8_value, bool case_sensitive, bool any_prefix, bool any_suffix);
+	};
+
+	/// A wrapper for a prefix predicate, for which the value of the struct member is required to start with
+	/// a given control value. Case-sensitive prefixes are evaluated as a range (member >= value AND member < next value),
+	/// which is served by a plain index on the member. Case-insensitive prefixes are evaluated with LIKE 'value%',
+	/// which is served by an index created with Database::CreateIndex(&T::member, true)
+	class REFLECTION_EXPORT StartsWith final : public TextPattern
+	{
+	public:
+		template <typename T>
+		explicit StartsWith(std::wstring T::* fn, const std::wstring& value, bool case_sensitive = true)
+			: TextPattern(case_sensitive ? ">=" : "LIKE",
+			                 PatternMemberName(GetMemberMetadata(fn)),
+			                 Placeholder(PatternMemberName(GetMemberMetadata(fn)), value, case_sensitive),
+			                 Parameters(value, case_sensitive)) {}
+
+		template <typename T>
+		explicit StartsWith(std::wstring T::* fn, const wchar_t* value, bool case_sensitive = true)
+			: StartsWith(fn, std::wstring(value), case_sensitive) {}
+
+		template <typename T>
+		explicit StartsWith(std::string T::* fn, const std::string& value, bool case_sensitive = true)
+			: TextPattern(case_sensitive ? ">=" : "LIKE",
+			                 PatternMemberName(GetMemberMetadata(fn)),
+			                 Placeholder(PatternMemberName(GetMemberMetadata(fn)), value, case_sensitive),
+			                 Parameters(value, case_sensitive)) {}
+
+		template <typename T>
+		explicit StartsWith(std::string T::* fn, const char* value, bool case_sensitive = true)
+			: StartsWith(fn, std::string(value), case_sensitive) {}
+
+	protected:
+		/// Returns the smallest text, which is greater than all texts starting with the given prefix,
+		/// or an empty text if there is no such upper bound
+		static std::wstring UpperBound(const std::wstring& prefix);
+
+		/// Returns the smallest byte string, which is greater than all byte strings starting with the given UTF-8 prefix,
+		/// as compared by the binary collation of SQLite, or an empty string if there is no such upper bound.
+		/// The bytes are used as they are, so that values which are not valid UTF-8 are supported as well
+		static std::string UpperBound(const std::string& utf8_prefix);
+
+		static std::string Placeholder(const std::string& member_name, const std::wstring& value, bool case_sensitive);
+		static std::string Placeholder(const std::string& member_name, const std::string& utf8_value, bool case_sensitive);
+		static std::vector<QueryParameter> Parameters(const std::wstring& value, bool case_sensitive);
+		static std::vector<QueryParameter> Parameters(const std::string& utf8_value, bool case_sensitive);
+	};
+
+	/// A wrapper for a suffix predicate, for which the value of the
+	/// struct member is required to end with a given control value
+	class REFLECTION_EXPORT EndsWith final : public TextPattern
+	{
+	public:
+		template <typename T>
+		explicit EndsWith(std::wstring T::* fn, const std::wstring& value, bool case_sensitive = true)
+			: TextPattern(PatternMemberName(GetMemberMetadata(fn)), value, case_sensitive, true, false) {}
+
+		template <typename T>
+		explicit EndsWith(std::wstring T::* fn, const wchar_t* value, bool case_sensitive = true)
+			: EndsWith(fn, std::wstring(value), case_sensitive) {}
+
+		template <typename T>
+		explicit EndsWith(std::string T::* fn, const std::string& value, bool case_sensitive = true)
+			: TextPattern(PatternMemberName(GetMemberMetadata(fn)), value, case_sensitive, true, false) {}
+
+		template <typename T>
+		explicit EndsWith(std::string T::* fn, const char* value, bool case_sensitive = true)
+			: EndsWith(fn, std::string(value), case_sensitive) {}
+	};
+
+	/// A wrapper for a containment predicate, for which the value of the
+	/// struct member is required to contain a given control value
+	class REFLECTION_EXPORT Contains final : public TextPattern
+	{
+	public:
+		template <typename T>
+		explicit Contains(std::wstring T::* fn, const std::wstring& value, bool case_sensitive = true)
+			: TextPattern(PatternMemberName(GetMemberMetadata(fn)), value, case_sensitive, true, true) {}
+
+		template <typename T>
+		explicit Contains(std::wstring T::* fn, const wchar_t* value, bool case_sensitive = true)
+			: Contains(fn, std::wstring(value), case_sensitive) {}
+
+		template <typename T>
+		explicit Contains(std::string T::* fn, const std::string& value, bool case_sensitive = true)
+			: TextPattern(PatternMemberName(GetMemberMetadata(fn)), value, case_sensitive, true, true) {}
+
+		template <typename T>
+		explicit Contains(std::string T::* fn, const char* value, bool case_sensitive = true)
+			: Contains(fn, std::string(value), case_sensitive) {}
 	};
 
 	/// A wrapper for a comparison predicate, for which the value of the
@@ -243,12 +398,92 @@ namespace sqlite_reflection {
 			: QueryPredicate(fn, value, "<=") {}
 	};
 
+	/// A wrapper for a membership predicate, for which the value of the struct member is required
+	/// to be equal to any of the given control values. This should be preferred over chaining
+	/// many equality predicates, since it is built in linear time and can be served by an index
+	class REFLECTION_EXPORT In final : public QueryPredicate
+	{
+	public:
+		template <typename T, typename R>
+		explicit In(R T::* fn, const std::vector<R>& values)
+			: QueryPredicate("IN", GetMemberMetadata(fn).name, "", std::vector<QueryParameter>()) {
+			const auto storage_class = GetMemberMetadata(fn).storage_class;
+			parameters_.reserve(values.size());
+			for (const auto& value : values) {
+				parameters_.emplace_back(QueryParameter::FromValue((void*)&value, storage_class));
+			}
+			Enclose();
+		}
+
+		template <typename T>
+		explicit In(int64_t T::* fn, const std::vector<int>& values)
+			: In(fn, std::vector<int64_t>(values.begin(), values.end())) {}
+
+		/// Constructs the predicate for an integer member which is only known at runtime, such as a reference member
+		explicit In(const Reflection::MemberMetadata& member, const std::vector<int64_t>& values);
+
+	protected:
+		/// Constructs the placeholder for all control values. Short lists get one placeholder per value, while longer
+		/// lists of scalar values are bound as a single JSON array, which is expanded by json_each. Longer lists of
+		/// binary values are padded to the next power of two, so that the number of distinct statements stays small
+		void Enclose();
+	};
+
+	/// A wrapper for a range predicate, for which the value of the struct member is required
+	/// to lie between a given lower and upper control value, both inclusive
+	class REFLECTION_EXPORT Between final : public QueryPredicate
+	{
+	public:
+		template <typename T, typename R>
+		explicit Between(R T::* fn, R lower, R upper)
+			: QueryPredicate("BETWEEN",
+			                 GetMemberMetadata(fn).name,
+			                 "? AND ?",
+			                 std::vector<QueryParameter>{QueryParameter::FromValue((void*)&lower, GetMemberMetadata(fn).storage_class),
+			                                             QueryParameter::FromValue((void*)&upper, GetMemberMetadata(fn).storage_class)}) {}
+
+		template <typename T>
+		explicit Between(int64_t T::* fn, int lower, int upper)
+			: Between(fn, (int64_t)lower, (int64_t)upper) {}
+
+		template <typename T>
+		explicit Between(std::wstring T::* fn, const wchar_t* lower, const wchar_t* upper)
+			: Between(fn, std::wstring(lower), std::wstring(upper)) {}
+
+		template <typename T>
+		explicit Between(std::string T::* fn, const char* lower, const char* upper)
+			: Between(fn, std::string(lower), std::string(upper)) {}
+	};
+
+	/// A wrapper for a full-text search predicate, for which the value of the struct member is required
+	/// to match a given FTS5 query, for example L"john" or L"app*". The member needs to be declared with
+	/// FTS_TEXT, so that the search is served by the full-text index instead of scanning all records
+	class REFLECTION_EXPORT Match final : public QueryPredicate
+	{
+	public:
+		template <typename T>
+		explicit Match(std::wstring T::* fn, const std::wstring& query)
+			: QueryPredicate("IN",
+			                 "id",
+			                 Subquery(GetRecordFromTypeId(typeid(T).name()), GetMemberMetadata(fn)),
+			                 std::vector<QueryParameter>{QueryParameter::FromValue((void*)&query, SqliteStorageClass::kText)}) {}
+
+		template <typename T>
+		explicit Match(std::wstring T::* fn, const wchar_t* query)
+			: Match(fn, std::wstring(query)) {}
+
+	protected:
+		/// Returns the subquery selecting the ids of all records, whose given member matches the control value
+		static std::string Subquery(const Reflection& record, const Reflection::MemberMetadata& member);
+	};
+
 	/// A wrapper of a compound predicate, which combines two other predicates,
 	/// allowing the construction of more complex predicates from elementary predicates
 	class REFLECTION_EXPORT BinaryPredicate : public QueryPredicateBase
 	{
 	public:
 		std::string Evaluate() const override;
+		std::string Evaluate(std::vector<QueryParameter>& parameters) const override;
 
 	protected:
 		BinaryPredicate(const QueryPredicateBase& left, const QueryPredicateBase& right, const std::string& symbol);
@@ -0,0 +1,161 @@
+// MIT License
+//
+// Copyright (c) 2023 Ioannis Kaliakatsos
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include "reflection_export.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct sqlite3;
+
+namespace sqlite_reflection {
+	/// A histogram of latencies with logarithmic buckets, in which each bucket spans
+	/// a power of two nanoseconds, so that recording a latency is a constant-time operation
+	class REFLECTION_EXPORT LatencyHistogram
+	{
+	public:
+		LatencyHistogram();
+
+		void Record(uint64_t nanoseconds);
+
+		/// The number of recorded latencies
+		uint64_t Count() const;
+
+		/// The sum of all recorded latencies in microseconds
+		double TotalMicroseconds() const;
+
+		/// Returns an estimate of the given percentile (between 0 and 100) of all recorded latencies in microseconds,
+		/// which is the upper bound of the bucket containing the percentile, and thus accurate within a factor of two
+		double Percentile(double percentile) const;
+
+		double P50() const;
+		double P99() const;
+
+	private:
+		std::array<uint64_t, 64> buckets_;
+		uint64_t count_;
+		uint64_t total_nanoseconds_;
+	};
+
+	/// The statistics of a single operation (for example Fetch) on the records of a single type
+	struct REFLECTION_EXPORT OperationStatistics
+	{
+		OperationStatistics() : rows(0), bytes(0) {}
+
+		/// The latencies of all executions of the operation
+		LatencyHistogram latency;
+
+		/// The number of records retrieved by all executions of the operation
+		uint64_t rows;
+
+		/// The number of bytes of all retrieved records, before hydration
+		uint64_t bytes;
+	};
+
+	/// An SQL statement whose execution took longer than the slow query threshold
+	struct REFLECTION_EXPORT SlowQuery
+	{
+		/// The SQL text of the statement, with the values of bound parameters expanded
+		std::string sql;
+
+		/// The output of EXPLAIN QUERY PLAN for the statement, one line per plan step
+		std::string query_plan;
+
+		double milliseconds;
+	};
+
+	/// A snapshot of the statistics collected since instrumentation was enabled
+	struct REFLECTION_EXPORT DatabaseStatistics
+	{
+		/// The statistics of each operation, keyed by the record name and the operation name, for example {"Person", "Fetch"}
+		std::map<std::pair<std::string, std::string>, OperationStatistics> operations;
+
+		/// The latencies of all SQL statements executed by SQLite, including the ones of raw SQL queries
+		LatencyHistogram statements;
+
+		/// The most recent slow queries, oldest first
+		std::vector<SlowQuery> slow_queries;
+	};
+
+	/// The storage footprint of the compressed text members of all records, as currently stored in the database
+	struct REFLECTION_EXPORT CompressionStatistics
+	{
+		CompressionStatistics() : values(0), compressed_values(0), uncompressed_bytes(0), stored_bytes(0) {}
+
+		/// The bytes saved by compression, which is negative if the codec headers outweigh the savings
+		int64_t BytesSaved() const {
+			return (int64_t)uncompressed_bytes - (int64_t)stored_bytes;
+		}
+
+		/// The number of stored values, and how many of them are compressed
+		uint64_t values;
+		uint64_t compressed_values;
+
+		/// The size of all values as UTF-8 text, and their size as actually stored
+		uint64_t uncompressed_bytes;
+		uint64_t stored_bytes;
+	};
+
+	/// Collects the statistics of a database connection. Statement latencies are reported by
+	/// SQLite itself through sqlite3_trace_v2, while operation latencies are measured around
+	/// each database operation
+	class REFLECTION_EXPORT Instrumentation
+	{
+	public:
+		typedef std::chrono::steady_clock Clock;
+
+		Instrumentation(sqlite3* db, double slow_query_threshold_milliseconds, size_t max_slow_queries = 100);
+		~Instrumentation();
+
+		Instrumentation(const Instrumentation&) = delete;
+		void operator=(const Instrumentation&) = delete;
+
+		void RecordOperation(const std::string& record_name, const char* operation, Clock::time_point start, uint64_t rows, uint64_t bytes);
+
+		/// Records the latency of a completed statement, and returns whether it is slow enough to be kept
+		/// as a slow query, so that its SQL only needs to be expanded for such statements
+		bool RecordStatement(uint64_t nanoseconds);
+
+		void RecordSlowQuery(const std::string& sql, uint64_t nanoseconds);
+
+		/// Returns the statistics collected so far. The query plans of slow queries are
+		/// retrieved at this point, so this should not be called while a query is executing
+		DatabaseStatistics Snapshot() const;
+
+	private:
+		std::string QueryPlan(const std::string& sql) const;
+
+		sqlite3* db_;
+		uint64_t slow_query_threshold_nanoseconds_;
+		size_t max_slow_queries_;
+		DatabaseStatistics statistics_;
+		mutable std::mutex mutex_;
+	};
+}
@@ -28,6 +28,9 @@
 #include <string>
 #include <functional>
 #include <stdexcept>
+#include <typeinfo>
+#include <cstring>
+#include <cstdint>
 
 #include "reflection_export.h"
 
@@ -43,7 +46,13 @@ enum class REFLECTION_EXPORT SqliteStorageClass
 	kReal,
 	kText,
 	kDateTime,
-    kBool
+    kBool,
+	kUtf8Text,
+	kBlob,
+	kRealArray,
+	kIntArray,
+	kIntArrayDelta,
+	kCompressedText
 };
 
 /// A struct holding all information needed for introspection of user-defined structs
@@ -56,8 +65,10 @@ struct REFLECTION_EXPORT Reflection
 	class MemberMetadata
 	{
 	public:
-		MemberMetadata(const std::string& _name, SqliteStorageClass _storage_class, size_t _offset)
-			: name(_name), storage_class(_storage_class), sqlite_column_name(ToSqliteColumnName(_storage_class)), offset(_offset) { }
+		MemberMetadata(const std::string& _name, SqliteStorageClass _storage_class, size_t _offset, bool _full_text_search = false,
+		               const std::string& _referenced_record = std::string())
+			: name(_name), storage_class(_storage_class), sqlite_column_name(ToSqliteColumnName(_storage_class)), offset(_offset),
+			  full_text_search(_full_text_search), referenced_record(_referenced_record) { }
 
 		/// The struct variable member name, as defined in the source code
 		std::string name;
@@ -72,6 +83,12 @@ struct REFLECTION_EXPORT Reflection
 		/// The memory offset in bytes of this member from the struct's start, including any padding bits
 		size_t offset;
 
+		/// Whether this text member is indexed for full-text search, in the FTS5 table of its containing struct
+		bool full_text_search;
+
+		/// The name of the record, whose id this integer member refers to, or empty if this member is not a reference
+		std::string referenced_record;
+
 	private:
 		/// Helper for conversion between member storage class and SQLite column name
 		static const char* ToSqliteColumnName(const SqliteStorageClass storage_class) {
@@ -82,9 +99,16 @@ struct REFLECTION_EXPORT Reflection
 			case SqliteStorageClass::kReal:
 				return "REAL";
 			case SqliteStorageClass::kText:
+			case SqliteStorageClass::kUtf8Text:
 				return "TEXT";
 			case SqliteStorageClass::kDateTime:
 				return "DATETIME";
+			case SqliteStorageClass::kBlob:
+			case SqliteStorageClass::kRealArray:
+			case SqliteStorageClass::kIntArray:
+			case SqliteStorageClass::kIntArrayDelta:
+			case SqliteStorageClass::kCompressedText:
+				return "BLOB";
 			default:
 				throw std::domain_error("Implementation error: storage class is not supported");
 			}
@@ -119,6 +143,8 @@ size_t OffsetFromStart(R T::* fn) {
 #define CAT(A, B) CAT_NOEXPAND(A, B)
 
 #define DEFINE_MEMBER(R, T)	reflectable.member_metadata.push_back(Reflection::MemberMetadata(STR(R), T, offsetof(struct REFLECTABLE, R)));
+#define DEFINE_FTS_MEMBER(R)	reflectable.member_metadata.push_back(Reflection::MemberMetadata(STR(R), SqliteStorageClass::kText, offsetof(struct REFLECTABLE, R), true));
+#define DEFINE_REF_MEMBER(T, R)	reflectable.member_metadata.push_back(Reflection::MemberMetadata(STR(R), SqliteStorageClass::kInt, offsetof(struct REFLECTABLE, R), false, STR(T)));
 
 /// A singleton object which holds all reflectable structs, and is guaranteed to be
 /// instantiated before main.cpp starts
@@ -147,6 +173,34 @@ REFLECTION_EXPORT Reflection& GetRecordFromTypeId(const std::string& type_id);
 /// }
 REFLECTION_EXPORT char* GetMemberAddress(void* p, const Reflection& record, size_t i);
 
+/// Returns whether any text member of this record is indexed for full-text search
+REFLECTION_EXPORT bool HasFullTextSearch(const Reflection& record);
+
+/// Returns the member of this record which refers to the given record, and throws
+/// if there is no such member, or if there are several of them
+REFLECTION_EXPORT const Reflection::MemberMetadata& ReferenceMember(const Reflection& record, const Reflection& referenced_record);
+
+/// Returns the name of the FTS5 table, which indexes the full-text search members of this record
+REFLECTION_EXPORT std::string FullTextSearchTableName(const Reflection& record);
+
+/// Returns a 64-bit FNV-1a hash of the schema of this record, which changes whenever
+/// a member is added, removed, renamed or its storage class changes
+REFLECTION_EXPORT uint64_t SchemaHash(const Reflection& record);
+
+/// Retrieves the metadata of a reflectable struct member, by enabling type-safe
+/// referencing of this member using a pointer-to-member function
+template <typename T, typename R>
+const Reflection::MemberMetadata& GetMemberMetadata(R T::* fn) {
+	const auto& record = GetRecordFromTypeId(typeid(T).name());
+	const auto offset = OffsetFromStart(fn);
+	for (const auto& member : record.member_metadata) {
+		if (member.offset == offset) {
+			return member;
+		}
+	}
+	throw std::invalid_argument("Member is not registered for record " + record.name);
+}
+
 #endif // REFLECTION_INTERNAL
 
 #include "time_point.h"
@@ -166,16 +220,32 @@ REFLECTION_EXPORT char* GetMemberAddress(void* p, const Reflection& record, size
 #define MEMBER_INT(R)				    MEMBER_DECLARE(int64_t, R)
 #define MEMBER_REAL(R)			        MEMBER_DECLARE(double, R)
 #define MEMBER_TEXT(R)	                MEMBER_DECLARE(std::wstring, R)
+#define MEMBER_UTF8(R)	                MEMBER_DECLARE(std::string, R)
+#define MEMBER_BLOB(R)	                MEMBER_DECLARE(std::vector<uint8_t>, R)
+#define MEMBER_REAL_ARRAY(R)	        MEMBER_DECLARE(std::vector<double>, R)
+#define MEMBER_INT_ARRAY(R)	            MEMBER_DECLARE(std::vector<int64_t>, R)
+#define MEMBER_INT_ARRAY_DELTA(R)	    MEMBER_DECLARE(std::vector<int64_t>, R)
+#define MEMBER_TEXT_COMPRESSED(R)	    MEMBER_DECLARE(std::wstring, R)
+#define MEMBER_REF(T, R)	            MEMBER_DECLARE(int64_t, R)
 #define MEMBER_DATETIME(R)              MEMBER_DECLARE(sqlite_reflection::TimePoint, R)
 #define MEMBER_BOOL(R)                  MEMBER_DECLARE(bool, R)
+#define FTS_TEXT(R)                     MEMBER_DECLARE(std::wstring, R)
 #define FUNC(SIGNATURE)
         FIELDS
 #undef MEMBER_DECLARE
 #undef MEMBER_INT
 #undef MEMBER_REAL
 #undef MEMBER_TEXT
+#undef MEMBER_UTF8
+#undef MEMBER_BLOB
+#undef MEMBER_REAL_ARRAY
+#undef MEMBER_INT_ARRAY
+#undef MEMBER_INT_ARRAY_DELTA
+#undef MEMBER_TEXT_COMPRESSED
+#undef MEMBER_REF
 #undef MEMBER_DATETIME
 #undef MEMBER_BOOL
+#undef FTS_TEXT
 #undef FUNC
                                         int64_t id;
 
@@ -183,15 +253,31 @@ REFLECTION_EXPORT char* GetMemberAddress(void* p, const Reflection& record, size
 #define MEMBER_INT(R)
 #define MEMBER_REAL(R)
 #define MEMBER_TEXT(R)
+#define MEMBER_UTF8(R)
+#define MEMBER_BLOB(R)
+#define MEMBER_REAL_ARRAY(R)
+#define MEMBER_INT_ARRAY(R)
+#define MEMBER_INT_ARRAY_DELTA(R)
+#define MEMBER_TEXT_COMPRESSED(R)
+#define MEMBER_REF(T, R)
 #define MEMBER_DATETIME(R)
 #define MEMBER_BOOL(R)
+#define FTS_TEXT(R)
 #define FUNC(SIGNATURE)                 SIGNATURE;
         FIELDS
 #undef MEMBER_INT
 #undef MEMBER_REAL
 #undef MEMBER_TEXT
+#undef MEMBER_UTF8
+#undef MEMBER_BLOB
+#undef MEMBER_REAL_ARRAY
+#undef MEMBER_INT_ARRAY
+#undef MEMBER_INT_ARRAY_DELTA
+#undef MEMBER_TEXT_COMPRESSED
+#undef MEMBER_REF
 #undef MEMBER_DATETIME
 #undef MEMBER_BOOL
+#undef FTS_TEXT
 #undef FUNC
     };
 
@@ -210,15 +296,31 @@ REFLECTION_EXPORT char* GetMemberAddress(void* p, const Reflection& record, size
 #define MEMBER_INT(R)                           DEFINE_MEMBER(R, SqliteStorageClass::kInt)
 #define MEMBER_REAL(R)                          DEFINE_MEMBER(R, SqliteStorageClass::kReal)
 #define MEMBER_TEXT(R)                          DEFINE_MEMBER(R, SqliteStorageClass::kText)
+#define MEMBER_UTF8(R)                          DEFINE_MEMBER(R, SqliteStorageClass::kUtf8Text)
+#define MEMBER_BLOB(R)                          DEFINE_MEMBER(R, SqliteStorageClass::kBlob)
+#define MEMBER_REAL_ARRAY(R)                    DEFINE_MEMBER(R, SqliteStorageClass::kRealArray)
+#define MEMBER_INT_ARRAY(R)                     DEFINE_MEMBER(R, SqliteStorageClass::kIntArray)
+#define MEMBER_INT_ARRAY_DELTA(R)               DEFINE_MEMBER(R, SqliteStorageClass::kIntArrayDelta)
+#define MEMBER_TEXT_COMPRESSED(R)               DEFINE_MEMBER(R, SqliteStorageClass::kCompressedText)
+#define MEMBER_REF(T, R)                        DEFINE_REF_MEMBER(T, R)
 #define MEMBER_DATETIME(R)                      DEFINE_MEMBER(R, SqliteStorageClass::kDateTime)
 #define MEMBER_BOOL(R)                          DEFINE_MEMBER(R, SqliteStorageClass::kBool)
+#define FTS_TEXT(R)                             DEFINE_FTS_MEMBER(R)
 #define FUNC(SIGNATURE)
             FIELDS
 #undef MEMBER_INT
 #undef MEMBER_REAL
 #undef MEMBER_TEXT
+#undef MEMBER_UTF8
+#undef MEMBER_BLOB
+#undef MEMBER_REAL_ARRAY
+#undef MEMBER_INT_ARRAY
+#undef MEMBER_INT_ARRAY_DELTA
+#undef MEMBER_TEXT_COMPRESSED
+#undef MEMBER_REF
 #undef MEMBER_DATETIME
 #undef MEMBER_BOOL
+#undef FTS_TEXT
 #undef FUNC
         }
         return name;
@@ -0,0 +1,175 @@
+// MIT License
+//
+// Copyright (c) 2023 Ioannis Kaliakatsos
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "database.h"
+
+namespace sqlite_reflection {
+	/// A set of independent databases (shards), among which records are distributed by a hash of their id, so
+	/// that hot tables can be spread over several files, for example on separate disks. Each record lives in
+	/// exactly one shard, which is determined by its id alone, so ids need to be assigned by the caller, instead
+	/// of being auto-incremented. Operations spanning several shards are performed on all shards in parallel,
+	/// each on its own connection
+	///
+	/// example:
+	/// ShardedDatabase db({"persons_0.db", "persons_1.db", "persons_2.db", "persons_3.db"});
+	/// db.Save(persons);
+	/// const auto person = db.Fetch<Person>(42);
+	/// const auto adults = db.Fetch<Person>(&adult_predicate);
+	class REFLECTION_EXPORT ShardedDatabase
+	{
+	public:
+		/// Opens one database per given file path, in the given order. The shard of each id depends on the number
+		/// of shards, so a sharded database needs to be opened with the same paths in the same order every time
+		explicit ShardedDatabase(const std::vector<std::string>& paths, TableCreation table_creation = TableCreation::kEager);
+
+		ShardedDatabase(ShardedDatabase&&) = default;
+		ShardedDatabase& operator=(ShardedDatabase&&) = default;
+
+		size_t ShardCount() const;
+
+		/// Returns the shard with the given index, for operations which are not routed automatically
+		const Database& Shard(size_t index) const;
+
+		/// Returns the index of the shard, in which the record with the given id is stored
+		size_t ShardIndex(int64_t id) const;
+
+		/// Returns the shard, in which the record with the given id is stored
+		const Database& ShardOf(int64_t id) const;
+
+		/// Saves a given record in its shard
+		template <typename T>
+		void Save(const T& model) const {
+			ShardOf(model.id).Save(model);
+		}
+
+		/// Saves multiple records, which are partitioned by shard and saved in all shards in parallel
+		template <typename T>
+		void Save(const std::vector<T>& models) const {
+			const auto partitions = Partition(models);
+			ForEachShard([this, &models, &partitions](size_t index) {
+				for (const auto i : partitions[index]) {
+					shards_[index].Save(models[i]);
+				}
+			});
+		}
+
+		/// Updates a given record in its shard
+		template <typename T>
+		void Update(const T& model) const {
+			ShardOf(model.id).Update(model);
+		}
+
+		/// Updates multiple records, which are partitioned by shard and updated in all shards in parallel
+		template <typename T>
+		void Update(const std::vector<T>& models) const {
+			const auto partitions = Partition(models);
+			ForEachShard([this, &models, &partitions](size_t index) {
+				for (const auto i : partitions[index]) {
+					shards_[index].Update(models[i]);
+				}
+			});
+		}
+
+		/// Deletes the record with the given id from its shard
+		template <typename T>
+		void Delete(int64_t id) const {
+			ShardOf(id).Delete<T>(id);
+		}
+
+		/// Retrieves the record with the given id from its shard
+		template <typename T>
+		T Fetch(int64_t id) const {
+			return ShardOf(id).Fetch<T>(id);
+		}
+
+		/// Retrieves all entries of a given record, which match a given predicate, from all shards in parallel.
+		/// The entries are grouped by shard, in the order of the shards
+		template <typename T>
+		std::vector<T> Fetch(const QueryPredicateBase* predicate) const {
+			std::vector<std::vector<T>> partitions(shards_.size());
+			ForEachShard([this, &partitions, predicate](size_t index) {
+				partitions[index] = shards_[index].Fetch<T>(predicate);
+			});
+			return Concatenate(partitions);
+		}
+
+		/// Retrieves all entries of a given record from all shards in parallel, grouped by shard
+		template <typename T>
+		std::vector<T> FetchAll() const {
+			const EmptyPredicate empty;
+			return Fetch<T>(&empty);
+		}
+
+		/// Counts the entries of a given record, which match a given predicate, in all shards
+		template <typename T>
+		int64_t Count(const QueryPredicateBase* predicate = nullptr) const {
+			std::vector<int64_t> counts(shards_.size());
+			ForEachShard([this, &counts, predicate](size_t index) {
+				counts[index] = shards_[index].Count<T>(predicate);
+			});
+			int64_t count = 0;
+			for (const auto shard_count : counts) {
+				count += shard_count;
+			}
+			return count;
+		}
+
+	private:
+		/// Runs the given function for the index of each shard, each on its own thread, and waits until all of them
+		/// are finished. The first exception thrown by any of them is rethrown, after all of them are finished
+		void ForEachShard(const std::function<void(size_t)>& fn) const;
+
+		/// Returns the indices of the given records per shard, so that the records are not copied
+		template <typename T>
+		std::vector<std::vector<size_t>> Partition(const std::vector<T>& models) const {
+			std::vector<std::vector<size_t>> partitions(shards_.size());
+			for (size_t i = 0; i < models.size(); ++i) {
+				partitions[ShardIndex(models[i].id)].push_back(i);
+			}
+			return partitions;
+		}
+
+		template <typename T>
+		static std::vector<T> Concatenate(std::vector<std::vector<T>>& partitions) {
+			size_t size = 0;
+			for (const auto& partition : partitions) {
+				size += partition.size();
+			}
+			std::vector<T> models;
+			models.reserve(size);
+			for (auto& partition : partitions) {
+				std::move(partition.begin(), partition.end(), std::back_inserter(models));
+			}
+			return models;
+		}
+
+		std::vector<Database> shards_;
+	};
+}
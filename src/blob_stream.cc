@@ -0,0 +1,234 @@
+// MIT License
+//
+// Copyright (c) 2023 Ioannis Kaliakatsos
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "blob_stream.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "internal/sqlite3.h"
+
+using namespace sqlite_reflection;
+
+BlobHandle::BlobHandle(sqlite3* db, const std::string& table, const std::string& column, const int64_t id, const bool writable)
+	: db_(db), blob_(nullptr), writable_(writable) {
+	if (sqlite3_blob_open(db_, "main", table.data(), column.data(), id, writable ? 1 : 0, &blob_)) {
+		const std::string error = sqlite3_errmsg(db_);
+		sqlite3_blob_close(blob_);
+		blob_ = nullptr;
+		throw std::runtime_error("Could not open blob " + column + " of record " + std::to_string(id) + " in table " + table + ": " + error);
+	}
+}
+
+BlobHandle::~BlobHandle() {
+	Close();
+}
+
+BlobHandle::BlobHandle(BlobHandle&& other) noexcept
+	: db_(other.db_), blob_(other.blob_), writable_(other.writable_) {
+	other.blob_ = nullptr;
+}
+
+BlobHandle& BlobHandle::operator=(BlobHandle&& other) noexcept {
+	if (this != &other) {
+		Close();
+		db_ = other.db_;
+		blob_ = other.blob_;
+		writable_ = other.writable_;
+		other.blob_ = nullptr;
+	}
+	return *this;
+}
+
+static void RequireOpen(sqlite3_blob* blob) {
+	if (blob == nullptr) {
+		throw std::runtime_error("The blob handle is closed");
+	}
+}
+
+size_t BlobHandle::Size() const {
+	RequireOpen(blob_);
+	return (size_t)sqlite3_blob_bytes(blob_);
+}
+
+bool BlobHandle::Writable() const {
+	return writable_;
+}
+
+size_t BlobHandle::Read(void* buffer, size_t length, const size_t offset) const {
+	const auto size = Size();
+	if (offset >= size) {
+		return 0;
+	}
+	length = std::min(length, size - offset);
+	if (sqlite3_blob_read(blob_, buffer, (int)length, (int)offset)) {
+		throw std::runtime_error(std::string("Could not read blob: ") + sqlite3_errmsg(db_));
+	}
+	return length;
+}
+
+void BlobHandle::Write(const void* data, const size_t length, const size_t offset) {
+	if (!writable_) {
+		throw std::runtime_error("The blob was not opened for writing");
+	}
+	if (offset + length > Size()) {
+		throw std::out_of_range("Writing past the end of the blob is not possible, the blob needs to be reserved with a larger size");
+	}
+	if (sqlite3_blob_write(blob_, data, (int)length, (int)offset)) {
+		throw std::runtime_error(std::string("Could not write blob: ") + sqlite3_errmsg(db_));
+	}
+}
+
+void BlobHandle::Reopen(const int64_t id) {
+	RequireOpen(blob_);
+	if (sqlite3_blob_reopen(blob_, id)) {
+		throw std::runtime_error("Could not open blob of record " + std::to_string(id) + ": " + sqlite3_errmsg(db_));
+	}
+}
+
+void BlobHandle::Close() {
+	if (blob_ != nullptr) {
+		sqlite3_blob_close(blob_);
+		blob_ = nullptr;
+	}
+}
+
+BlobStreamBuffer::BlobStreamBuffer(BlobHandle& blob, const size_t chunk_size)
+	: blob_(blob), buffer_(std::max(chunk_size, (size_t)1)), buffer_offset_(0) {}
+
+BlobStreamBuffer::~BlobStreamBuffer() {
+	try {
+		Flush();
+	}
+	catch (...) {
+	}
+}
+
+size_t BlobStreamBuffer::Position() const {
+	if (gptr() != nullptr) {
+		return buffer_offset_ + (gptr() - eback());
+	}
+	if (pbase() != nullptr) {
+		return buffer_offset_ + (pptr() - pbase());
+	}
+	return buffer_offset_;
+}
+
+bool BlobStreamBuffer::Flush() {
+	if (pbase() == nullptr) {
+		return true;
+	}
+	const size_t length = pptr() - pbase();
+	if (length > 0) {
+		if (buffer_offset_ + length > blob_.Size()) {
+			return false;
+		}
+		blob_.Write(pbase(), length, buffer_offset_);
+		buffer_offset_ += length;
+	}
+	setp(buffer_.data(), buffer_.data() + buffer_.size());
+	return true;
+}
+
+BlobStreamBuffer::int_type BlobStreamBuffer::underflow() {
+	if (gptr() != nullptr && gptr() < egptr()) {
+		return traits_type::to_int_type(*gptr());
+	}
+
+	// the put area is written out before switching to reading
+	const auto position = Position();
+	if (!Flush()) {
+		return traits_type::eof();
+	}
+	setp(nullptr, nullptr);
+	buffer_offset_ = position;
+
+	const auto length = blob_.Read(buffer_.data(), buffer_.size(), position);
+	if (length == 0) {
+		setg(nullptr, nullptr, nullptr);
+		return traits_type::eof();
+	}
+	setg(buffer_.data(), buffer_.data(), buffer_.data() + length);
+	return traits_type::to_int_type(*gptr());
+}
+
+BlobStreamBuffer::int_type BlobStreamBuffer::overflow(const int_type c) {
+	if (!blob_.Writable()) {
+		return traits_type::eof();
+	}
+
+	if (pbase() == nullptr) {
+		// the get area is discarded before switching to writing
+		buffer_offset_ = Position();
+		setg(nullptr, nullptr, nullptr);
+		setp(buffer_.data(), buffer_.data() + buffer_.size());
+	} else if (!Flush()) {
+		return traits_type::eof();
+	}
+
+	if (!traits_type::eq_int_type(c, traits_type::eof())) {
+		*pptr() = traits_type::to_char_type(c);
+		pbump(1);
+	}
+	return traits_type::not_eof(c);
+}
+
+int BlobStreamBuffer::sync() {
+	return Flush() ? 0 : -1;
+}
+
+std::streamsize BlobStreamBuffer::showmanyc() {
+	const auto position = Position();
+	const auto size = blob_.Size();
+	return position < size ? (std::streamsize)(size - position) : -1;
+}
+
+BlobStreamBuffer::pos_type BlobStreamBuffer::seekoff(const off_type offset, const std::ios_base::seekdir direction, const std::ios_base::openmode mode) {
+	const auto position = (off_type)Position();
+	if (offset == 0 && direction == std::ios_base::cur) {
+		return pos_type(position);
+	}
+
+	off_type base = 0;
+	if (direction == std::ios_base::cur) {
+		base = position;
+	} else if (direction == std::ios_base::end) {
+		base = (off_type)blob_.Size();
+	}
+	return seekpos(pos_type(base + offset), mode);
+}
+
+BlobStreamBuffer::pos_type BlobStreamBuffer::seekpos(const pos_type position, std::ios_base::openmode) {
+	const auto target = (off_type)position;
+	if (target < 0 || target > (off_type)blob_.Size() || !Flush()) {
+		return pos_type(off_type(-1));
+	}
+	setg(nullptr, nullptr, nullptr);
+	setp(nullptr, nullptr);
+	buffer_offset_ = (size_t)target;
+	return position;
+}
+
+BlobStream::BlobStream(BlobHandle& blob, const size_t chunk_size)
+	: std::iostream(nullptr), buffer_(blob, chunk_size) {
+	rdbuf(&buffer_);
+}
@@ -25,79 +25,475 @@
 #include <stdexcept>
 #include <memory>
 #include <iterator>
+#include <algorithm>
 
 #include "internal/string_utilities.h"
+#include "internal/text_compression.h"
 #include "queries.h"
 #include "internal/sqlite3.h"
 
 namespace sqlite_reflection {
 	Database* Database::instance_ = nullptr;
 
+	/// How long a statement waits for a file to be unlocked by another connection, for example by a running backup
+	const int busy_timeout_milliseconds = 5000;
+
+	/// Measures the latency of a single operation on the records of a given type, if instrumentation is enabled
+	class OperationScope
+	{
+	public:
+		OperationScope(Instrumentation* instrumentation, const Reflection& record, const char* operation)
+			: instrumentation_(instrumentation), record_(record), operation_(operation), rows_(0), bytes_(0) {
+			if (instrumentation_ != nullptr) {
+				start_ = Instrumentation::Clock::now();
+			}
+		}
+
+		~OperationScope() {
+			if (instrumentation_ != nullptr) {
+				instrumentation_->RecordOperation(record_.name, operation_, start_, rows_, bytes_);
+			}
+		}
+
+		/// Counts the retrieved records
+		void Count(uint64_t rows) {
+			rows_ = rows;
+		}
+
+		/// The counter of the bytes of all retrieved values, or null if instrumentation is disabled
+		uint64_t* Bytes() {
+			return instrumentation_ != nullptr ? &bytes_ : nullptr;
+		}
+
+	private:
+		Instrumentation* instrumentation_;
+		const Reflection& record_;
+		const char* operation_;
+		Instrumentation::Clock::time_point start_;
+		uint64_t rows_;
+		uint64_t bytes_;
+	};
+
 	const ReflectionRegister& GetReflectionRegister() {
 		return *GetReflectionRegisterInstance();
 	}
 
-	void Database::Initialize(const std::string& path) {
+	void Database::Initialize(const std::string& path, TableCreation table_creation) {
 		if (instance_ != nullptr) {
 			throw std::invalid_argument("Database has already been initialized");
 		}
 
-		const auto effective_path = path != "" ? path : ":memory:";
-		instance_ = new Database(effective_path.data());
+		instance_ = new Database(path, table_creation);
 	}
 
 	void Database::Finalize() {
-		if (instance_ != nullptr) {
-			sqlite3_close(instance_->db_);
-			delete instance_;
-			instance_ = nullptr;
+		delete instance_;
+		instance_ = nullptr;
+	}
+
+	/// Copies the main database of a source connection to the main database of a destination connection, a given number
+	/// of pages at a time, or all at once for a negative number. Between steps other connections get the chance to
+	/// lock the source, and steps which find it locked are retried
+	static void CopyDatabase(sqlite3* destination, sqlite3* source, int pages_per_step, const BackupProgress& progress) {
+		const auto backup = sqlite3_backup_init(destination, "main", source, "main");
+		if (backup == nullptr) {
+			throw std::runtime_error(std::string("Backup could not be started: ") + sqlite3_errmsg(destination));
+		}
+
+		auto result = SQLITE_OK;
+		while (result == SQLITE_OK || result == SQLITE_BUSY || result == SQLITE_LOCKED) {
+			result = sqlite3_backup_step(backup, pages_per_step);
+			if (progress && result != SQLITE_BUSY && result != SQLITE_LOCKED) {
+				progress(sqlite3_backup_remaining(backup), sqlite3_backup_pagecount(backup));
+			}
+			if (result != SQLITE_DONE && pages_per_step >= 0) {
+				sqlite3_sleep(result == SQLITE_OK ? 0 : 10);
+			}
+		}
+		sqlite3_backup_finish(backup);
+
+		if (result != SQLITE_DONE) {
+			throw std::runtime_error(std::string("Backup failed: ") + sqlite3_errstr(result));
 		}
 	}
 
-	Database::Database(const char* path)
-		: db_(nullptr) {
-		if (sqlite3_open(path, &db_)) {
+	Database::Database(const std::string& path, TableCreation table_creation)
+		: Database(path, table_creation, std::string()) {}
+
+	Database::Database(const std::string& path, TableCreation table_creation, const std::string& snapshot_path)
+		: db_(nullptr), table_creation_(table_creation) {
+		const auto effective_path = path != "" ? path : ":memory:";
+		if (sqlite3_open(effective_path.data(), &db_)) {
+			sqlite3_close_v2(db_);
 			throw std::invalid_argument("Database could not be initialized");
 		}
+		sqlite3_busy_timeout(db_, busy_timeout_milliseconds);
 
-		auto& reg = GetReflectionRegister();
-		for (const auto& contents : reg.records) {
-			const auto& record = contents.second;
+		try {
+			if (!snapshot_path.empty()) {
+				sqlite3* snapshot = nullptr;
+				if (sqlite3_open_v2(snapshot_path.data(), &snapshot, SQLITE_OPEN_READONLY, nullptr)) {
+					sqlite3_close_v2(snapshot);
+					throw std::invalid_argument("Database snapshot " + snapshot_path + " could not be opened");
+				}
+				try {
+					CopyDatabase(db_, snapshot, -1, nullptr);
+				}
+				catch (...) {
+					sqlite3_close_v2(snapshot);
+					throw;
+				}
+				sqlite3_close_v2(snapshot);
+			}
+
+			SchemaSnapshotQuery snapshot_query(db_);
+			schema_snapshot_ = snapshot_query.GetSnapshot();
+
+			if (table_creation_ == TableCreation::kEager) {
+				std::vector<const Reflection*> records;
+				for (const auto& contents : GetReflectionRegister().records) {
+					records.push_back(&contents.second);
+				}
+				Migrate(records, schema_snapshot_);
+				schema_snapshot_ = SchemaSnapshot();
+			}
+		}
+		catch (...) {
+			sqlite3_close_v2(db_);
+			throw;
+		}
+
+		statement_cache_.reset(new StatementCache(db_));
+	}
+
+	Database Database::LoadFromFile(const std::string& path, TableCreation table_creation) {
+		return Database("", table_creation, path);
+	}
+
+	Database::~Database() {
+		Close();
+	}
+
+	Database::Database(Database&& other) noexcept
+		: db_(other.db_), statement_cache_(std::move(other.statement_cache_)), schema_snapshot_(std::move(other.schema_snapshot_)),
+		  table_creation_(other.table_creation_), instrumentation_(std::move(other.instrumentation_)) {
+		std::lock_guard<std::mutex> lock(other.ready_tables_mutex_);
+		ready_tables_ = std::move(other.ready_tables_);
+		std::lock_guard<std::mutex> backups_lock(other.backups_mutex_);
+		backups_ = std::move(other.backups_);
+		other.db_ = nullptr;
+	}
+
+	Database& Database::operator=(Database&& other) noexcept {
+		if (this != &other) {
+			Close();
+			std::lock(ready_tables_mutex_, other.ready_tables_mutex_);
+			std::lock_guard<std::mutex> lock(ready_tables_mutex_, std::adopt_lock);
+			std::lock_guard<std::mutex> other_lock(other.ready_tables_mutex_, std::adopt_lock);
+			db_ = other.db_;
+			statement_cache_ = std::move(other.statement_cache_);
+			schema_snapshot_ = std::move(other.schema_snapshot_);
+			ready_tables_ = std::move(other.ready_tables_);
+			table_creation_ = other.table_creation_;
+			instrumentation_ = std::move(other.instrumentation_);
+			std::lock_guard<std::mutex> backups_lock(other.backups_mutex_);
+			backups_ = std::move(other.backups_);
+			other.db_ = nullptr;
+		}
+		return *this;
+	}
+
+	void Database::Close() {
+		// backups copy from the connection on their own threads
+		{
+			std::lock_guard<std::mutex> lock(backups_mutex_);
+			for (const auto& backup : backups_) {
+				backup.wait();
+			}
+			backups_.clear();
+		}
+
+		// statements need to be finalized and tracing stopped before the connection is closed
+		instrumentation_.reset();
+		statement_cache_.reset();
+		if (db_ != nullptr) {
+			sqlite3_close_v2(db_);
+			db_ = nullptr;
+		}
+	}
+
+	void Database::Migrate(const std::vector<const Reflection*>& records, const SchemaSnapshot& snapshot) const {
+		// all tables are created or migrated in a single transaction, so that
+		// a failing migration leaves the database file untouched
+		if (sqlite3_exec(db_, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr)) {
+			throw std::domain_error("Fatal error in transaction start");
+		}
+		try {
+			for (const auto record : records) {
+				Migrate(*record, snapshot);
+			}
+		}
+		catch (...) {
+			sqlite3_exec(db_, "ROLLBACK;", nullptr, nullptr, nullptr);
+			throw;
+		}
+		if (sqlite3_exec(db_, "COMMIT;", nullptr, nullptr, nullptr)) {
+			throw std::domain_error("Fatal error in transaction commit");
+		}
+	}
+
+	void Database::Migrate(const Reflection& record, const SchemaSnapshot& snapshot) const {
+		const auto table_exists = snapshot.table_names.find(record.name) != snapshot.table_names.end();
+		const auto schema_hash = SchemaHash(record);
+		const auto recorded_schema_hash = snapshot.schema_hashes.find(record.name);
+		if (table_exists && recorded_schema_hash != snapshot.schema_hashes.end() && recorded_schema_hash->second == schema_hash) {
+			return;
+		}
+
+		if (table_exists) {
+			TableColumnsQuery columns_query(db_, record);
+			MigrateTableQuery query(db_, record, columns_query.GetColumnNames());
+			query.Execute();
+		} else {
 			CreateTableQuery query(db_, record);
 			query.Execute();
 		}
+
+		// references are looked up when fetching related records, which would otherwise scan the whole table
+		for (const auto& member : record.member_metadata) {
+			if (!member.referenced_record.empty()) {
+				CreateIndexQuery index_query(db_, record, member.name, false);
+				index_query.Execute();
+			}
+		}
+
+		SaveSchemaHashQuery save_schema_hash_query(db_, record, schema_hash);
+		save_schema_hash_query.Execute();
+	}
+
+	void Database::EnsureTable(const Reflection& record) const {
+		if (table_creation_ == TableCreation::kEager) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(ready_tables_mutex_);
+		if (ready_tables_.find(&record) != ready_tables_.end()) {
+			return;
+		}
+		Migrate(std::vector<const Reflection*>{&record}, schema_snapshot_);
+		ready_tables_.insert(&record);
 	}
 
 	const Database& Database::Instance() {
 		return *instance_;
 	}
 
-	FetchQueryResults Database::Fetch(const Reflection& record, const QueryPredicateBase* predicate) const {
-		FetchRecordsQuery query(db_, record, predicate);
-		return query.GetResults();
+	void Database::Fetch(const Reflection& record, const QueryPredicateBase* predicate, const OrderBy* order_by, int64_t limit,
+	                     const std::function<void*()>& next_record) const {
+		EnsureTable(record);
+		OperationScope scope(instrumentation_.get(), record, "Fetch");
+		FetchRecordsQuery query(db_, record, predicate, order_by, limit, statement_cache_.get());
+		scope.Count(query.GetResults(next_record, scope.Bytes()));
 	}
 
 	const Reflection& Database::GetRecord(const std::string& type_id) {
 		return GetReflectionRegister().records.at(type_id);
 	}
 
-	void Database::Save(void* p, const Reflection& record) const {
-		InsertQuery query(db_, record, p);
-		query.Execute();
+	void Database::Aggregate(const Reflection& record, const std::string& aggregate, const QueryPredicateBase* predicate, void* p, SqliteStorageClass storage_class) const {
+		EnsureTable(record);
+		OperationScope scope(instrumentation_.get(), record, "Aggregate");
+		FetchAggregateQuery query(db_, record, aggregate, predicate, statement_cache_.get());
+		query.GetResult(p, storage_class);
+	}
+
+	bool Database::Exists(const Reflection& record, const QueryPredicateBase* predicate) const {
+		EnsureTable(record);
+		OperationScope scope(instrumentation_.get(), record, "Exists");
+		ExistsQuery query(db_, record, predicate, statement_cache_.get());
+		return query.Exists();
+	}
+
+	void Database::Join(const Reflection& record, const std::string& member_name, const QueryPredicateBase* predicate,
+	                     const Reflection& joined_record, const std::string& joined_member_name, const QueryPredicateBase* joined_predicate,
+	                     const std::function<std::pair<void*, void*>()>& next_row) const {
+		EnsureTable(record);
+		EnsureTable(joined_record);
+		OperationScope scope(instrumentation_.get(), record, "Join");
+		JoinRecordsQuery query(db_, record, member_name, predicate, joined_record, joined_member_name, joined_predicate, statement_cache_.get());
+		scope.Count(query.GetResults(next_row));
+	}
+
+	void Database::FetchGrouped(const Reflection& record, const std::string& group_column, const std::vector<std::string>& aggregates,
+	                            const QueryPredicateBase* predicate, const std::vector<SqliteStorageClass>& storage_classes,
+	                            const std::function<std::vector<void*>()>& next_row) const {
+		EnsureTable(record);
+		OperationScope scope(instrumentation_.get(), record, "GroupBy");
+		FetchGroupedQuery query(db_, record, group_column, aggregates, predicate, statement_cache_.get());
+		query.GetResults(storage_classes, next_row);
+	}
+
+	void Database::Search(const Reflection& record, const std::string& member_name, const QueryParameter& search_query, int64_t limit,
+	                      const std::function<void*()>& next_record) const {
+		EnsureTable(record);
+		OperationScope scope(instrumentation_.get(), record, "Search");
+		SearchRecordsQuery query(db_, record, member_name, search_query, limit, statement_cache_.get());
+		scope.Count(query.GetResults(next_record, scope.Bytes()));
+	}
+
+	void Database::Query(const Reflection& record, const std::string& sql, const std::vector<QueryParameter>& parameters,
+	                     const std::function<void*()>& next_record) const {
+		EnsureTable(record);
+		OperationScope scope(instrumentation_.get(), record, "Query");
+		auto cursor = OpenCursor(sql, parameters);
+		uint64_t rows = 0;
+		while (cursor.Next()) {
+			cursor.Read(next_record(), record);
+			++rows;
+		}
+		scope.Count(rows);
+	}
+
+	std::unique_ptr<FetchRecordsQuery> Database::PrepareFetch(const Reflection& record, const QueryPredicateBase* predicate, const OrderBy* order_by, int64_t limit) const {
+		EnsureTable(record);
+		return std::unique_ptr<FetchRecordsQuery>(new FetchRecordsQuery(db_, record, predicate, order_by, limit));
+	}
+
+	int64_t Database::GetMaxId(const Reflection& record) const {
+		EnsureTable(record);
+		OperationScope scope(instrumentation_.get(), record, "GetMaxId");
+		FetchMaxIdQuery query(db_, record);
+		return query.GetMaxId();
+	}
+
+	int64_t Database::Save(void* p, const Reflection& record, bool auto_increment_id) const {
+		EnsureTable(record);
+		OperationScope scope(instrumentation_.get(), record, auto_increment_id ? "SaveAutoIncrement" : "Save");
+		InsertQuery query(db_, record, p, auto_increment_id, statement_cache_.get());
+		return query.Insert();
 	}
 
 	void Database::Update(void* p, const Reflection& record) const {
-		UpdateQuery query(db_, record, p);
-		query.Execute();
+		EnsureTable(record);
+		OperationScope scope(instrumentation_.get(), record, "Update");
+		UpdateQuery query(db_, record, p, statement_cache_.get());
+		query.Update();
 	}
 
 	void Database::Delete(const Reflection& record, const QueryPredicateBase* predicate) const {
-		DeleteQuery query(db_, record, predicate);
+		EnsureTable(record);
+		OperationScope scope(instrumentation_.get(), record, "Delete");
+		DeleteQuery query(db_, record, predicate, statement_cache_.get());
+		query.Delete();
+	}
+
+	void Database::CreateIndex(const Reflection& record, const std::string& member_name, bool case_insensitive) const {
+		EnsureTable(record);
+		CreateIndexQuery query(db_, record, member_name, case_insensitive);
+		query.Execute();
+	}
+
+	BlobHandle Database::OpenBlob(const Reflection& record, const std::string& member_name, int64_t id, bool writable) const {
+		EnsureTable(record);
+		return BlobHandle(db_, record.name, member_name, id, writable);
+	}
+
+	void Database::ReserveBlob(const Reflection& record, const std::string& member_name, int64_t id, size_t size) const {
+		EnsureTable(record);
+		OperationScope scope(instrumentation_.get(), record, "ReserveBlob");
+		ReserveBlobQuery query(db_, record, member_name, id, size);
 		query.Execute();
 	}
 
+	void Database::EnableInstrumentation(double slow_query_threshold_milliseconds) const {
+		instrumentation_.reset();
+		instrumentation_.reset(new Instrumentation(db_, slow_query_threshold_milliseconds));
+	}
+
+	void Database::DisableInstrumentation() const {
+		instrumentation_.reset();
+	}
+
+	DatabaseStatistics Database::Stats() const {
+		return instrumentation_ != nullptr
+			       ? instrumentation_->Snapshot()
+			       : DatabaseStatistics();
+	}
+
+	CompressionStatistics Database::CompressionStats() const {
+		CompressionStatistics statistics;
+		for (const auto& contents : GetReflectionRegister().records) {
+			const auto& record = contents.second;
+			for (const auto& member : record.member_metadata) {
+				if (member.storage_class != SqliteStorageClass::kCompressedText) {
+					continue;
+				}
+				EnsureTable(record);
+				CompressionStatisticsQuery query(db_, record, member.name);
+				query.Accumulate(statistics);
+			}
+		}
+		return statistics;
+	}
+
+	bool Database::IsCompressionAvailable() {
+		return TextCompression::IsAvailable();
+	}
+
     void Database::Sql(const std::string& raw_sql_query) const {
         SqlQuery sql(db_, raw_sql_query);
         sql.Execute();
     }
+
+	Cursor Database::OpenCursor(const std::string& sql, const std::vector<QueryParameter>& parameters) const {
+		return Cursor(db_, sql, parameters, statement_cache_.get());
+	}
+
+	std::shared_future<void> Database::BackupTo(const std::string& path, const int pages_per_step, const BackupProgress& progress) const {
+		if (pages_per_step <= 0) {
+			throw std::invalid_argument("A backup needs to copy at least one page per step");
+		}
+
+		// file databases are read through a separate connection, so that the background thread never uses the connection
+		// of this database. In-memory databases are only visible to their own connection, which is then shared with the
+		// background thread, and thus needs to be serialized by SQLite
+		sqlite3* source = nullptr;
+		const auto file_name = sqlite3_db_filename(db_, "main");
+		if (file_name != nullptr && file_name[0] != '\0') {
+			if (sqlite3_open_v2(file_name, &source, SQLITE_OPEN_READONLY, nullptr)) {
+				sqlite3_close_v2(source);
+				throw std::runtime_error(std::string("Database ") + file_name + " could not be opened for a backup");
+			}
+		} else if (sqlite3_db_mutex(db_) == nullptr) {
+			throw std::runtime_error("In-memory databases can only be backed up if SQLite serializes access to their connection");
+		}
+
+		sqlite3* destination = nullptr;
+		if (sqlite3_open(path.data(), &destination)) {
+			sqlite3_close_v2(destination);
+			sqlite3_close_v2(source);
+			throw std::invalid_argument("Backup file " + path + " could not be opened");
+		}
+
+		const auto shared_source = db_;
+		const auto backup = std::async(std::launch::async, [destination, source, shared_source, pages_per_step, progress]() {
+			try {
+				CopyDatabase(destination, source != nullptr ? source : shared_source, pages_per_step, progress);
+			}
+			catch (...) {
+				sqlite3_close_v2(destination);
+				sqlite3_close_v2(source);
+				throw;
+			}
+			sqlite3_close_v2(destination);
+			sqlite3_close_v2(source);
+		}).share();
+
+		std::lock_guard<std::mutex> lock(backups_mutex_);
+		backups_.erase(std::remove_if(backups_.begin(), backups_.end(), [](const std::shared_future<void>& finished_backup) {
+			return finished_backup.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+		}), backups_.end());
+		backups_.push_back(backup);
+		return backup;
+	}
 }
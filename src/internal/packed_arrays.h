@@ -0,0 +1,50 @@
+// MIT License
+//
+// Copyright (c) 2023 Ioannis Kaliakatsos
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include "reflection_export.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sqlite_reflection {
+	/// Conversions between numeric arrays and the compact blobs they are stored in. Arrays are packed as
+	/// little-endian 8-byte values, so that on little-endian hosts packing and unpacking is a single memcpy.
+	/// Delta-encoded integer arrays store the zigzag-encoded difference of each value to its predecessor
+	/// as a variable-length integer, which takes a single byte for slowly increasing series, such as timestamps
+	class REFLECTION_EXPORT PackedArrays
+	{
+	public:
+		/// Whether the host stores numbers in little-endian byte order, in which case
+		/// arrays are packed exactly as they are laid out in memory
+		static bool IsLittleEndian();
+
+		static std::string Pack(const std::vector<int64_t>& values);
+		static std::string Pack(const std::vector<double>& values);
+		static std::string PackDeltas(const std::vector<int64_t>& values);
+
+		static void Unpack(const void* data, size_t size, std::vector<int64_t>& values);
+		static void Unpack(const void* data, size_t size, std::vector<double>& values);
+		static void UnpackDeltas(const void* data, size_t size, std::vector<int64_t>& values);
+	};
+}
@@ -0,0 +1,61 @@
+// MIT License
+//
+// Copyright (c) 2023 Ioannis Kaliakatsos
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include "reflection_export.h"
+
+#include <cstdint>
+#include <string>
+
+namespace sqlite_reflection {
+	/// Conversions between the text of compressed members and the blobs they are stored in. Each blob starts
+	/// with a single byte identifying its codec: either the UTF-8 text follows as is, or the size of the UTF-8
+	/// text follows as a little-endian 8-byte value, followed by its zlib-compressed bytes. Text is only
+	/// compressed when it is at least kThreshold bytes long, zlib is available and compression actually
+	/// reduces its size, so that short values are not penalized
+	class REFLECTION_EXPORT TextCompression
+	{
+	public:
+		enum Codec : uint8_t {
+			kStored = 0,
+			kZlib = 1
+		};
+
+		/// The minimum size in bytes of UTF-8 text to be compressed
+		static const size_t kThreshold = 512;
+
+		/// The size of the header of a blob, which is the codec byte and the size of the uncompressed text
+		static const size_t kMaxHeaderSize = 9;
+
+		/// Whether the library was built with zlib, without which text is never compressed
+		static bool IsAvailable();
+
+		static std::string Compress(const std::string& utf8_text);
+
+		/// Restores the UTF-8 text of a stored blob. Throws if the blob is malformed,
+		/// or if it is compressed and the library was built without zlib
+		static std::string Decompress(const void* data, size_t size);
+
+		/// Returns the size of the UTF-8 text of a stored blob of a given size, given only its first (up to kMaxHeaderSize) bytes
+		static uint64_t UncompressedSize(const void* header, size_t header_size, size_t blob_size);
+	};
+}
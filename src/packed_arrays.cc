@@ -0,0 +1,129 @@
+// MIT License
+//
+// Copyright (c) 2023 Ioannis Kaliakatsos
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "internal/packed_arrays.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+using namespace sqlite_reflection;
+
+bool PackedArrays::IsLittleEndian() {
+	const uint16_t probe = 1;
+	uint8_t first_byte;
+	memcpy(&first_byte, &probe, 1);
+	return first_byte == 1;
+}
+
+/// Copies 8-byte values between memory and their little-endian representation, reversing the bytes of each value on big-endian hosts
+static void CopyLittleEndian(void* destination, const void* source, const size_t count) {
+	const auto size = count * sizeof(uint64_t);
+	memcpy(destination, source, size);
+	if (PackedArrays::IsLittleEndian()) {
+		return;
+	}
+	auto bytes = (uint8_t*)destination;
+	for (size_t i = 0; i < size; i += sizeof(uint64_t)) {
+		for (size_t j = 0; j < sizeof(uint64_t) / 2; ++j) {
+			std::swap(bytes[i + j], bytes[i + sizeof(uint64_t) - 1 - j]);
+		}
+	}
+}
+
+template <typename T>
+static std::string PackValues(const std::vector<T>& values) {
+	std::string packed(values.size() * sizeof(T), '\0');
+	if (!values.empty()) {
+		CopyLittleEndian(&packed[0], values.data(), values.size());
+	}
+	return packed;
+}
+
+template <typename T>
+static void UnpackValues(const void* data, const size_t size, std::vector<T>& values) {
+	if (size % sizeof(T) != 0) {
+		throw std::runtime_error("Packed array has an invalid size of " + std::to_string(size) + " bytes");
+	}
+	values.resize(size / sizeof(T));
+	if (!values.empty()) {
+		CopyLittleEndian(values.data(), data, values.size());
+	}
+}
+
+std::string PackedArrays::Pack(const std::vector<int64_t>& values) {
+	return PackValues(values);
+}
+
+std::string PackedArrays::Pack(const std::vector<double>& values) {
+	return PackValues(values);
+}
+
+void PackedArrays::Unpack(const void* data, const size_t size, std::vector<int64_t>& values) {
+	UnpackValues(data, size, values);
+}
+
+void PackedArrays::Unpack(const void* data, const size_t size, std::vector<double>& values) {
+	UnpackValues(data, size, values);
+}
+
+std::string PackedArrays::PackDeltas(const std::vector<int64_t>& values) {
+	std::string packed;
+	packed.reserve(values.size() * 2);
+	uint64_t previous = 0;
+	for (const auto value : values) {
+		// all arithmetic is unsigned, so that differences wrap around instead of overflowing
+		const auto delta = (uint64_t)value - previous;
+		auto zigzag = (delta << 1) ^ ((delta >> 63) != 0 ? ~(uint64_t)0 : 0);
+		previous = (uint64_t)value;
+
+		while (zigzag >= 0x80) {
+			packed += (char)((zigzag & 0x7F) | 0x80);
+			zigzag >>= 7;
+		}
+		packed += (char)zigzag;
+	}
+	return packed;
+}
+
+void PackedArrays::UnpackDeltas(const void* data, const size_t size, std::vector<int64_t>& values) {
+	values.clear();
+	const auto bytes = (const uint8_t*)data;
+	uint64_t previous = 0;
+	size_t i = 0;
+	while (i < size) {
+		uint64_t zigzag = 0;
+		for (unsigned shift = 0;; shift += 7) {
+			if (i == size || shift > 63) {
+				throw std::runtime_error("Delta-encoded array is truncated or corrupt");
+			}
+			const auto byte = bytes[i++];
+			zigzag |= (uint64_t)(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0) {
+				break;
+			}
+		}
+		const auto delta = (zigzag >> 1) ^ (0 - (zigzag & 1));
+		previous += delta;
+		values.push_back((int64_t)previous);
+	}
+}
@@ -31,12 +31,155 @@
 
 #include "internal/sqlite3.h"
 #include "internal/string_utilities.h"
-#include "fetch_query_results.h"
+#include "internal/packed_arrays.h"
+#include "internal/text_compression.h"
 
 using namespace sqlite_reflection;
 
-Query::Query(sqlite3* db, const Reflection& record)
-	: db_(db), record_(record) {}
+/// The table holding the schema hash of every record table, as recorded during its last migration
+static const std::string schema_table("_reflection_schema");
+
+/// The record of queries which are not bound to any reflectable struct
+static const Reflection& NoRecord() {
+	static const Reflection record;
+	return record;
+}
+
+/// Creates the FTS5 table indexing all full-text search members of a record,
+/// together with the triggers which keep it in sync with the record table
+static std::string FullTextSearchSql(const Reflection& record);
+
+namespace {
+	/// Resets a statement when leaving the scope in which its rows are read, also when reading a row throws,
+	/// so that statements which are kept for repeated execution can be bound and executed again
+	class StatementReset
+	{
+	public:
+		explicit StatementReset(sqlite3_stmt* stmt)
+			: stmt_(stmt) {}
+
+		~StatementReset() {
+			sqlite3_reset(stmt_);
+		}
+
+		StatementReset(const StatementReset&) = delete;
+		void operator=(const StatementReset&) = delete;
+
+	private:
+		sqlite3_stmt* stmt_;
+	};
+}
+
+/// Writes the value of a given result column of an evaluated statement to a type-erased address,
+/// based on its concrete type. NULL values leave the contents of the given address untouched
+static void ReadColumnValue(sqlite3_stmt* stmt, const int col, void* p, const SqliteStorageClass storage_class) {
+	if (sqlite3_column_type(stmt, col) == SQLITE_NULL) {
+		return;
+	}
+
+	switch (storage_class) {
+	case SqliteStorageClass::kInt:
+		*(int64_t*)p = sqlite3_column_int64(stmt, col);
+		break;
+
+	case SqliteStorageClass::kBool:
+		*(bool*)p = sqlite3_column_int64(stmt, col) != 0;
+		break;
+
+	case SqliteStorageClass::kReal:
+		*(double*)p = sqlite3_column_double(stmt, col);
+		break;
+
+	case SqliteStorageClass::kText:
+		*(std::wstring*)p = StringUtilities::FromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, col)));
+		break;
+
+	case SqliteStorageClass::kUtf8Text:
+		(*(std::string*)p).assign(reinterpret_cast<const char*>(sqlite3_column_text(stmt, col)), sqlite3_column_bytes(stmt, col));
+		break;
+
+	case SqliteStorageClass::kBlob:
+		{
+			const auto data = reinterpret_cast<const uint8_t*>(sqlite3_column_blob(stmt, col));
+			const auto size = sqlite3_column_bytes(stmt, col);
+			auto& blob = *(std::vector<uint8_t>*)p;
+			data != nullptr
+				? blob.assign(data, data + size)
+				: blob.clear();
+			break;
+		}
+
+	case SqliteStorageClass::kRealArray:
+		PackedArrays::Unpack(sqlite3_column_blob(stmt, col), sqlite3_column_bytes(stmt, col), *(std::vector<double>*)p);
+		break;
+
+	case SqliteStorageClass::kIntArray:
+		PackedArrays::Unpack(sqlite3_column_blob(stmt, col), sqlite3_column_bytes(stmt, col), *(std::vector<int64_t>*)p);
+		break;
+
+	case SqliteStorageClass::kIntArrayDelta:
+		PackedArrays::UnpackDeltas(sqlite3_column_blob(stmt, col), sqlite3_column_bytes(stmt, col), *(std::vector<int64_t>*)p);
+		break;
+
+	case SqliteStorageClass::kCompressedText:
+		*(std::wstring*)p = StringUtilities::FromUtf8(TextCompression::Decompress(sqlite3_column_blob(stmt, col), sqlite3_column_bytes(stmt, col)).c_str());
+		break;
+
+	case SqliteStorageClass::kDateTime:
+		*(TimePoint*)p = TimePoint::FromSystemTime(StringUtilities::FromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, col))));
+		break;
+
+	default:
+		break;
+	}
+}
+
+StatementCache::StatementCache(sqlite3* db, const size_t capacity)
+	: db_(db), capacity_(capacity) {}
+
+StatementCache::~StatementCache() {
+	Clear();
+}
+
+sqlite3_stmt* StatementCache::Acquire(const std::string& sql) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		const auto it = statements_.find(sql);
+		if (it != statements_.end()) {
+			const auto stmt = it->second;
+			statements_.erase(it);
+			return stmt;
+		}
+	}
+
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db_, sql.data(), -1, &stmt, nullptr)) {
+		sqlite3_finalize(stmt);
+		return nullptr;
+	}
+	return stmt;
+}
+
+void StatementCache::Release(const std::string& sql, sqlite3_stmt* stmt) {
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (statements_.size() >= capacity_ || !statements_.emplace(sql, stmt).second) {
+		sqlite3_finalize(stmt);
+	}
+}
+
+void StatementCache::Clear() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (const auto& contents : statements_) {
+		sqlite3_finalize(contents.second);
+	}
+	statements_.clear();
+}
+
+Query::Query(sqlite3* db, const Reflection& record, StatementCache* cache)
+	: db_(db), record_(record), cache_(cache) {}
 
 std::string Query::JoinedRecordColumnNames() const {
 	const auto column_names = GetRecordColumnNames();
@@ -56,11 +199,86 @@ std::string Query::CustomizedColumnName(size_t index) const {
 	return record_.member_metadata[index].name;
 }
 
-ExecutionQuery::ExecutionQuery(sqlite3* db, const Reflection& record)
-	: Query(db, record) {}
+std::string Query::WhereClause(const QueryPredicateBase* predicate, std::vector<QueryParameter>& parameters) {
+	if (predicate == nullptr) {
+		return "";
+	}
+	const auto condition_evaluation = predicate->Evaluate(parameters);
+	return condition_evaluation.empty()
+		       ? ""
+		       : " WHERE " + condition_evaluation;
+}
+
+sqlite3_stmt* Query::AcquireStatement(const std::string& sql) const {
+	if (cache_ != nullptr) {
+		return cache_->Acquire(sql);
+	}
+
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db_, sql.data(), -1, &stmt, nullptr)) {
+		sqlite3_finalize(stmt);
+		return nullptr;
+	}
+	return stmt;
+}
+
+void Query::ReleaseStatement(const std::string& sql, sqlite3_stmt* stmt) const {
+	if (stmt == nullptr) {
+		return;
+	}
+	if (cache_ != nullptr) {
+		cache_->Release(sql, stmt);
+	} else {
+		sqlite3_finalize(stmt);
+	}
+}
+
+void Query::BindParameters(sqlite3_stmt* stmt, const std::vector<QueryParameter>& parameters) {
+	for (auto i = 0; i < parameters.size(); ++i) {
+		const auto& parameter = parameters[i];
+		const auto index = i + 1;
+		switch (parameter.storage_class) {
+		case SqliteStorageClass::kInt:
+		case SqliteStorageClass::kBool:
+			sqlite3_bind_int64(stmt, index, parameter.int_value);
+			break;
+
+		case SqliteStorageClass::kReal:
+			sqlite3_bind_double(stmt, index, parameter.real_value);
+			break;
+
+		case SqliteStorageClass::kText:
+		case SqliteStorageClass::kUtf8Text:
+		case SqliteStorageClass::kDateTime:
+			sqlite3_bind_text(stmt, index, parameter.text_value.data(), (int)parameter.text_value.length(), SQLITE_STATIC);
+			break;
+
+		case SqliteStorageClass::kBlob:
+		case SqliteStorageClass::kRealArray:
+		case SqliteStorageClass::kIntArray:
+		case SqliteStorageClass::kIntArrayDelta:
+		case SqliteStorageClass::kCompressedText:
+			sqlite3_bind_blob(stmt, index, parameter.text_value.data(), (int)parameter.text_value.length(), SQLITE_STATIC);
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
+ExecutionQuery::ExecutionQuery(sqlite3* db, const Reflection& record, StatementCache* cache)
+	: Query(db, record, cache) {}
 
 void ExecutionQuery::Execute() const {
 	const auto sql = PrepareSql();
+	if (!sqlite3_get_autocommit(db_)) {
+		if (sqlite3_exec(db_, sql.data(), nullptr, nullptr, nullptr)) {
+			throw std::domain_error((sql + ": Query could not be executed").data());
+		}
+		return;
+	}
+
 	if (sqlite3_exec(db_, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr)) {
 		throw std::domain_error("Fatal error in transaction start");
 	}
@@ -73,62 +291,128 @@ void ExecutionQuery::Execute() const {
 	}
 }
 
-std::vector<std::string> ExecutionQuery::GetValues(void* p) const {
-	const auto& members = record_.member_metadata;
-	std::vector<std::string> values;
+/// Binds a blob without copying it, where an empty blob is bound as a zero-length blob instead of NULL
+static void BindStaticBlob(sqlite3_stmt* stmt, const int index, const void* data, const size_t size) {
+	sqlite3_bind_blob(stmt, index, size > 0 ? data : "", (int)size, SQLITE_STATIC);
+}
+
+int64_t ExecutionQuery::Execute(void* p, const std::vector<size_t>& member_indices) const {
+	const auto sql = PrepareSql();
+	const auto stmt = AcquireStatement(sql);
+	if (stmt == nullptr) {
+		throw std::domain_error((sql + ": Query could not be executed").data());
+	}
 
-	for (auto j = 0; j < members.size(); j++) {
-		const auto current_column = members[j].name;
-		const auto current_storage_class = members[j].storage_class;
-		std::string content;
+	// wide text and datetime members are converted to UTF-8 first, and the converted values
+	// are kept alive until the statement is evaluated, so that no member is copied by SQLite
+	std::vector<std::string> converted_values;
+	converted_values.reserve(member_indices.size());
 
-		switch (current_storage_class) {
-		case SqliteStorageClass::kInt:
-			{
-				const auto& value = (*(int64_t*)((void*)GetMemberAddress(p, record_, j)));
-				content = StringUtilities::FromInt(value);
+	// the statement is returned to the cache even if converting a member throws, since it is not finalized otherwise
+	try {
+		for (auto i = 0; i < member_indices.size(); ++i) {
+			const auto j = member_indices[i];
+			const auto index = i + 1;
+			const auto address = (void*)GetMemberAddress(p, record_, j);
+
+			switch (record_.member_metadata[j].storage_class) {
+			case SqliteStorageClass::kInt:
+				sqlite3_bind_int64(stmt, index, *(int64_t*)address);
 				break;
-			}
-                
-        case SqliteStorageClass::kBool:
-            {
-                const auto& value = (*(bool*)((void*)GetMemberAddress(p, record_, j)));
-                content = StringUtilities::FromInt(value ? 1 : 0);
-                break;
-            }
 
-		case SqliteStorageClass::kReal:
-			{
-				const auto& value = (*(double*)((void*)GetMemberAddress(p, record_, j)));
-				content = StringUtilities::FromDouble(value);
+			case SqliteStorageClass::kBool:
+				sqlite3_bind_int64(stmt, index, *(bool*)address ? 1 : 0);
 				break;
-			}
 
-		case SqliteStorageClass::kText:
-			{
-				auto& value = (*(std::wstring*)((void*)GetMemberAddress(p, record_, j)));
-				content = StringUtilities::ToUtf8(value);
+			case SqliteStorageClass::kReal:
+				sqlite3_bind_double(stmt, index, *(double*)address);
 				break;
-			}
 
-		case SqliteStorageClass::kDateTime:
-			{
-				auto& value = (*(TimePoint*)((void*)GetMemberAddress(p, record_, j)));
-				content = StringUtilities::ToUtf8(value.SystemTime());
+			case SqliteStorageClass::kText:
+				converted_values.emplace_back(StringUtilities::ToUtf8(*(std::wstring*)address));
+				sqlite3_bind_text(stmt, index, converted_values.back().data(), (int)converted_values.back().length(), SQLITE_STATIC);
 				break;
-			}
 
-		default:
-			break;
+			case SqliteStorageClass::kUtf8Text:
+				{
+					const auto& value = *(std::string*)address;
+					sqlite3_bind_text(stmt, index, value.data(), (int)value.length(), SQLITE_STATIC);
+					break;
+				}
+
+			case SqliteStorageClass::kDateTime:
+				converted_values.emplace_back(StringUtilities::ToUtf8((*(TimePoint*)address).SystemTime()));
+				sqlite3_bind_text(stmt, index, converted_values.back().data(), (int)converted_values.back().length(), SQLITE_STATIC);
+				break;
+
+			case SqliteStorageClass::kBlob:
+				{
+					const auto& value = *(std::vector<uint8_t>*)address;
+					BindStaticBlob(stmt, index, value.data(), value.size());
+					break;
+				}
+
+			case SqliteStorageClass::kRealArray:
+				{
+					// 8-byte values are packed as they are laid out in memory on little-endian hosts
+					const auto& value = *(std::vector<double>*)address;
+					if (PackedArrays::IsLittleEndian()) {
+						BindStaticBlob(stmt, index, value.data(), value.size() * sizeof(double));
+					} else {
+						converted_values.emplace_back(PackedArrays::Pack(value));
+						BindStaticBlob(stmt, index, converted_values.back().data(), converted_values.back().size());
+					}
+					break;
+				}
+
+			case SqliteStorageClass::kIntArray:
+				{
+					const auto& value = *(std::vector<int64_t>*)address;
+					if (PackedArrays::IsLittleEndian()) {
+						BindStaticBlob(stmt, index, value.data(), value.size() * sizeof(int64_t));
+					} else {
+						converted_values.emplace_back(PackedArrays::Pack(value));
+						BindStaticBlob(stmt, index, converted_values.back().data(), converted_values.back().size());
+					}
+					break;
+				}
+
+			case SqliteStorageClass::kIntArrayDelta:
+				converted_values.emplace_back(PackedArrays::PackDeltas(*(std::vector<int64_t>*)address));
+				BindStaticBlob(stmt, index, converted_values.back().data(), converted_values.back().size());
+				break;
+
+			case SqliteStorageClass::kCompressedText:
+				converted_values.emplace_back(TextCompression::Compress(StringUtilities::ToUtf8(*(std::wstring*)address)));
+				BindStaticBlob(stmt, index, converted_values.back().data(), converted_values.back().size());
+				break;
+
+			default:
+				break;
+			}
 		}
-		values.emplace_back("'" + content + "'");
+	}
+	catch (...) {
+		ReleaseStatement(sql, stmt);
+		throw;
 	}
 
-	return values;
+	int64_t returned_value = 0;
+	auto result = sqlite3_step(stmt);
+	if (result == SQLITE_ROW) {
+		returned_value = sqlite3_column_int64(stmt, 0);
+		result = sqlite3_step(stmt);
+	}
+	ReleaseStatement(sql, stmt);
+
+	if (result != SQLITE_DONE) {
+		throw std::domain_error((sql + ": Query could not be executed").data());
+	}
+	return returned_value;
 }
 
 SqlQuery::SqlQuery(sqlite3* db, const std::string& sql)
-: ExecutionQuery(db, Reflection()), sql_(sql) {}
+: ExecutionQuery(db, NoRecord()), sql_(sql) {}
 
 std::string SqlQuery::PrepareSql() const {
     return sql_.length() > 0 && sql_[sql_.length() - 1] != ';'
@@ -136,225 +420,718 @@ std::string SqlQuery::PrepareSql() const {
     : sql_;
 }
 
+/// Returns the foreign key clause of a column, for members which refer to the id of another record
+static std::string ReferenceClause(const Reflection::MemberMetadata& member) {
+	return member.referenced_record.empty()
+		       ? ""
+		       : " REFERENCES " + member.referenced_record + "(id)";
+}
+
 CreateTableQuery::CreateTableQuery(sqlite3* db, const Reflection& record)
 	: ExecutionQuery(db, record) { }
 
 std::string CreateTableQuery::PrepareSql() const {
 	std::string sql("CREATE TABLE IF NOT EXISTS ");
 	sql += record_.name + " (" + JoinedRecordColumnNames() + ");";
+	if (HasFullTextSearch(record_)) {
+		sql += FullTextSearchSql(record_);
+	}
+	return sql;
+}
+
+static std::string FullTextSearchSql(const Reflection& record) {
+	std::vector<std::string> columns;
+	std::vector<std::string> new_values;
+	std::vector<std::string> old_values;
+	for (const auto& member : record.member_metadata) {
+		if (member.full_text_search) {
+			columns.emplace_back(member.name);
+			new_values.emplace_back("new." + member.name);
+			old_values.emplace_back("old." + member.name);
+		}
+	}
+
+	const auto fts_table = FullTextSearchTableName(record);
+	const auto joined_columns = StringUtilities::Join(columns, ", ");
+	const auto insert_new = "INSERT INTO " + fts_table + " (rowid, " + joined_columns + ") VALUES (new.id, "
+		+ StringUtilities::Join(new_values, ", ") + ");";
+	const auto delete_old = "INSERT INTO " + fts_table + " (" + fts_table + ", rowid, " + joined_columns + ") VALUES ('delete', old.id, "
+		+ StringUtilities::Join(old_values, ", ") + ");";
+
+	// external content table: the text is stored only once, in the record table, and the index is kept in sync
+	// by triggers on every insertion and deletion, and on updates which assign any of the indexed columns
+	std::string sql("CREATE VIRTUAL TABLE IF NOT EXISTS ");
+	sql += fts_table + " USING fts5(" + joined_columns + ", content='" + record.name + "', content_rowid='id');";
+	sql += "CREATE TRIGGER IF NOT EXISTS " + fts_table + "_insert AFTER INSERT ON " + record.name + " BEGIN " + insert_new + " END;";
+	sql += "CREATE TRIGGER IF NOT EXISTS " + fts_table + "_delete AFTER DELETE ON " + record.name + " BEGIN " + delete_old + " END;";
+	sql += "CREATE TRIGGER IF NOT EXISTS " + fts_table + "_update AFTER UPDATE OF " + joined_columns + " ON " + record.name
+		+ " BEGIN " + delete_old + " " + insert_new + " END;";
+	return sql;
+}
+
+MigrateTableQuery::MigrateTableQuery(sqlite3* db, const Reflection& record, const std::vector<std::string>& existing_columns)
+	: ExecutionQuery(db, record), existing_columns_(existing_columns) {}
+
+std::string MigrateTableQuery::PrepareSql() const {
+	std::string sql;
+	for (const auto& member : record_.member_metadata) {
+		const auto exists = std::find(existing_columns_.begin(), existing_columns_.end(), member.name) != existing_columns_.end();
+		if (!exists) {
+			sql += "ALTER TABLE " + record_.name + " ADD COLUMN " + member.name + " " + member.sqlite_column_name + ReferenceClause(member) + ";";
+		}
+	}
+
+	// the full-text search members may have changed as well, so the index is always recreated
+	const auto fts_table = FullTextSearchTableName(record_);
+	sql += "DROP TRIGGER IF EXISTS " + fts_table + "_insert;";
+	sql += "DROP TRIGGER IF EXISTS " + fts_table + "_delete;";
+	sql += "DROP TRIGGER IF EXISTS " + fts_table + "_update;";
+	sql += "DROP TABLE IF EXISTS " + fts_table + ";";
+	if (HasFullTextSearch(record_)) {
+		sql += FullTextSearchSql(record_);
+		sql += "INSERT INTO " + fts_table + " (" + fts_table + ") VALUES ('rebuild');";
+	}
+	return sql;
+}
+
+TableColumnsQuery::TableColumnsQuery(sqlite3* db, const Reflection& record)
+	: Query(db, record), stmt_(nullptr) {}
+
+TableColumnsQuery::~TableColumnsQuery() {
+	if (stmt_) {
+		sqlite3_finalize(stmt_);
+	}
+}
+
+std::string TableColumnsQuery::PrepareSql() const {
+	return "PRAGMA table_info(" + record_.name + ");";
+}
+
+std::vector<std::string> TableColumnsQuery::GetColumnNames() {
+	const auto sql = PrepareSql();
+	if (sqlite3_prepare_v2(db_, sql.data(), -1, &stmt_, nullptr)) {
+		throw std::runtime_error("Could not retrieve the columns of table " + record_.name);
+	}
+
+	std::vector<std::string> column_names;
+	while (sqlite3_step(stmt_) == SQLITE_ROW) {
+		// each row describes a single column: cid, name, type, notnull, dflt_value, pk
+		column_names.emplace_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt_, 1)));
+	}
+	return column_names;
+}
+
+SchemaSnapshotQuery::SchemaSnapshotQuery(sqlite3* db)
+	: Query(db, NoRecord()) {}
+
+std::string SchemaSnapshotQuery::PrepareSql() const {
+	return "SELECT name FROM sqlite_master WHERE type = 'table';";
+}
+
+SchemaSnapshot SchemaSnapshotQuery::GetSnapshot() const {
+	SchemaSnapshot snapshot;
+
+	sqlite3_stmt* stmt = nullptr;
+	const auto sql = PrepareSql();
+	if (sqlite3_prepare_v2(db_, sql.data(), -1, &stmt, nullptr)) {
+		sqlite3_finalize(stmt);
+		throw std::runtime_error("Could not retrieve the schema of the database");
+	}
+	while (sqlite3_step(stmt) == SQLITE_ROW) {
+		snapshot.table_names.emplace(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
+	}
+	sqlite3_finalize(stmt);
+
+	// the schema table does not exist before the first migration
+	if (snapshot.table_names.find(schema_table) == snapshot.table_names.end()) {
+		return snapshot;
+	}
+
+	const auto hashes_sql = "SELECT name, hash FROM " + schema_table + ";";
+	if (sqlite3_prepare_v2(db_, hashes_sql.data(), -1, &stmt, nullptr)) {
+		sqlite3_finalize(stmt);
+		throw std::runtime_error("Could not retrieve the schema hashes of the database");
+	}
+	while (sqlite3_step(stmt) == SQLITE_ROW) {
+		const auto name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+		snapshot.schema_hashes[name] = (uint64_t)sqlite3_column_int64(stmt, 1);
+	}
+	sqlite3_finalize(stmt);
+
+	return snapshot;
+}
+
+SaveSchemaHashQuery::SaveSchemaHashQuery(sqlite3* db, const Reflection& record, const uint64_t hash)
+	: ExecutionQuery(db, record), hash_(hash) {}
+
+std::string SaveSchemaHashQuery::PrepareSql() const {
+	std::string sql("CREATE TABLE IF NOT EXISTS ");
+	sql += schema_table + " (name TEXT PRIMARY KEY, hash INTEGER);";
+	sql += "INSERT OR REPLACE INTO " + schema_table + " (name, hash) VALUES ('" + record_.name + "', " + StringUtilities::FromInt((int64_t)hash_) + ");";
 	return sql;
 }
 
 std::string CreateTableQuery::CustomizedColumnName(size_t index) const {
 	auto name = Query::CustomizedColumnName(index);
 	const auto is_id = name.compare(std::string("id")) == 0;
-	name += " " + record_.member_metadata[index].sqlite_column_name;
+	name += " " + record_.member_metadata[index].sqlite_column_name + ReferenceClause(record_.member_metadata[index]);
 
 	return is_id
 		       ? name + " PRIMARY KEY"
 		       : name;
 }
 
-DeleteQuery::DeleteQuery(sqlite3* db, const Reflection& record, const QueryPredicateBase* predicate)
-	: ExecutionQuery(db, record), predicate_(predicate) {}
+CreateIndexQuery::CreateIndexQuery(sqlite3* db, const Reflection& record, const std::string& member_name, const bool case_insensitive)
+	: ExecutionQuery(db, record), member_name_(member_name), case_insensitive_(case_insensitive) {}
 
-std::string DeleteQuery::PrepareSql() const {
-	std::string sql("DELETE FROM ");
-	sql += record_.name + " WHERE " + predicate_->Evaluate() + ";";
+std::string CreateIndexQuery::PrepareSql() const {
+	const auto index_name = record_.name + "_" + member_name_ + (case_insensitive_ ? "_nocase" : "");
+	std::string sql("CREATE INDEX IF NOT EXISTS ");
+	sql += index_name + " ON " + record_.name + " (" + member_name_ + (case_insensitive_ ? " COLLATE NOCASE" : "") + ");";
+	return sql;
+}
+
+ReserveBlobQuery::ReserveBlobQuery(sqlite3* db, const Reflection& record, const std::string& member_name, const int64_t id, const size_t size)
+	: ExecutionQuery(db, record), member_name_(member_name), id_(id), size_(size) {}
+
+std::string ReserveBlobQuery::PrepareSql() const {
+	std::string sql("UPDATE ");
+	sql += record_.name + " SET " + member_name_ + " = zeroblob(" + StringUtilities::FromInt((int64_t)size_) + ")";
+	sql += " WHERE id = " + StringUtilities::FromInt(id_) + ";";
 	return sql;
 }
 
-InsertQuery::InsertQuery(sqlite3* db, const Reflection& record, void* p)
-	: ExecutionQuery(db, record), p_(p) {}
+CompressionStatisticsQuery::CompressionStatisticsQuery(sqlite3* db, const Reflection& record, const std::string& member_name)
+	: Query(db, record), member_name_(member_name) {}
+
+std::string CompressionStatisticsQuery::PrepareSql() const {
+	const auto header_size = StringUtilities::FromInt((int64_t)TextCompression::kMaxHeaderSize);
+	return "SELECT length(" + member_name_ + "), substr(" + member_name_ + ", 1, " + header_size + ") FROM " + record_.name + ";";
+}
+
+void CompressionStatisticsQuery::Accumulate(CompressionStatistics& statistics) const {
+	const auto sql = PrepareSql();
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db_, sql.data(), -1, &stmt, nullptr) != SQLITE_OK) {
+		sqlite3_finalize(stmt);
+		throw std::runtime_error("Could not measure the compressed values of " + record_.name + "." + member_name_);
+	}
+
+	while (sqlite3_step(stmt) == SQLITE_ROW) {
+		const auto stored_size = (size_t)sqlite3_column_int64(stmt, 0);
+		const auto header = reinterpret_cast<const uint8_t*>(sqlite3_column_blob(stmt, 1));
+		const auto header_size = (size_t)sqlite3_column_bytes(stmt, 1);
+
+		statistics.values += 1;
+		statistics.stored_bytes += stored_size;
+		statistics.uncompressed_bytes += TextCompression::UncompressedSize(header, header_size, stored_size);
+		if (header_size > 0 && header[0] != TextCompression::kStored) {
+			statistics.compressed_values += 1;
+		}
+	}
+	sqlite3_finalize(stmt);
+}
+
+DeleteQuery::DeleteQuery(sqlite3* db, const Reflection& record, const QueryPredicateBase* predicate, StatementCache* cache)
+	: ExecutionQuery(db, record, cache) {
+	where_clause_ = WhereClause(predicate, parameters_);
+}
+
+std::string DeleteQuery::PrepareSql() const {
+	return "DELETE FROM " + record_.name + where_clause_ + ";";
+}
+
+void DeleteQuery::Delete() const {
+	const auto sql = PrepareSql();
+	const auto stmt = AcquireStatement(sql);
+	if (stmt == nullptr) {
+		throw std::domain_error((sql + ": Query could not be executed").data());
+	}
+
+	BindParameters(stmt, parameters_);
+	const auto result = sqlite3_step(stmt);
+	ReleaseStatement(sql, stmt);
+
+	if (result != SQLITE_DONE) {
+		throw std::domain_error((sql + ": Query could not be executed").data());
+	}
+}
+
+InsertQuery::InsertQuery(sqlite3* db, const Reflection& record, void* p, const bool auto_increment_id, StatementCache* cache)
+	: ExecutionQuery(db, record, cache), p_(p), auto_increment_id_(auto_increment_id) {}
 
 std::string InsertQuery::PrepareSql() const {
+	const auto all_columns = GetRecordColumnNames();
+	const auto members = InsertedMembers();
+
+	std::vector<std::string> columns;
+	columns.reserve(members.size());
+	for (const auto j : members) {
+		columns.emplace_back(all_columns[j]);
+	}
+
 	std::string sql("INSERT INTO ");
-	sql += record_.name + " (" + JoinedRecordColumnNames() + ") VALUES (";
-	sql += JoinedValues() + ");";
+	sql += record_.name + " (" + StringUtilities::Join(columns, ", ") + ") VALUES (";
+	sql += StringUtilities::Join(std::vector<std::string>(columns.size(), "?"), ", ") + ") RETURNING id;";
 	return sql;
 }
 
-std::string InsertQuery::JoinedValues() const {
-	const auto values = GetValues(p_);
-	return StringUtilities::Join(values, ", ");
+std::vector<size_t> InsertQuery::InsertedMembers() const {
+	// the id is the first member, and an omitted INTEGER PRIMARY KEY is assigned by SQLite
+	std::vector<size_t> members;
+	members.reserve(record_.member_metadata.size());
+	for (auto j = auto_increment_id_ ? 1 : 0; j < record_.member_metadata.size(); ++j) {
+		members.push_back(j);
+	}
+	return members;
 }
 
-UpdateQuery::UpdateQuery(sqlite3* db, const Reflection& record, void* p)
-	: ExecutionQuery(db, record), p_(p) {}
+int64_t InsertQuery::Insert() const {
+	return Execute(p_, InsertedMembers());
+}
+
+UpdateQuery::UpdateQuery(sqlite3* db, const Reflection& record, void* p, StatementCache* cache)
+	: ExecutionQuery(db, record, cache), p_(p) {}
 
 std::string UpdateQuery::PrepareSql() const {
 	std::string sql("UPDATE ");
 	sql += record_.name + " SET ";
 
-	auto columns = GetRecordColumnNames();
-	const auto values = GetValues(p_);
-
-	std::vector<std::string> columns_with_values;
-	columns_with_values.reserve(values.size());
+	const auto columns = GetRecordColumnNames();
+	std::vector<std::string> columns_with_placeholders;
+	columns_with_placeholders.reserve(columns.size() - 1);
 	std::transform(columns.begin() + 1,
 	               columns.end(),
-	               values.begin() + 1,
-	               std::back_inserter(columns_with_values),
-	               [](const std::string& column, const std::string& value){
-		               return column + "=" + value;
+	               std::back_inserter(columns_with_placeholders),
+	               [](const std::string& column){
+		               return column + "=?";
 	               });
 
-	sql += StringUtilities::Join(columns_with_values, ", ");
-	sql += " WHERE " + columns[0] + "=" + values[0];
+	sql += StringUtilities::Join(columns_with_placeholders, ", ");
+	sql += " WHERE " + columns[0] + "=?";
 	sql += ";";
 
 	return sql;
 }
 
-FetchMaxIdQuery::FetchMaxIdQuery(sqlite3* db, const Reflection& record)
-	: Query(db, record), stmt_(nullptr) {}
-
-FetchMaxIdQuery::~FetchMaxIdQuery() {
-	if (stmt_) {
-		sqlite3_finalize(stmt_);
+void UpdateQuery::Update() const {
+	// all members except for the id are set, and the id is bound last, in the WHERE clause
+	std::vector<size_t> members;
+	members.reserve(record_.member_metadata.size());
+	for (auto j = 1; j < record_.member_metadata.size(); ++j) {
+		members.push_back(j);
 	}
+	members.push_back(0);
+	Execute(p_, members);
 }
 
-std::string FetchMaxIdQuery::PrepareSql() const {
-	return "SELECT MAX(id) FROM " + record_.name + ";";
+FetchAggregateQuery::FetchAggregateQuery(sqlite3* db, const Reflection& record, const std::string& aggregate, const QueryPredicateBase* predicate,
+                                         StatementCache* cache)
+	: Query(db, record, cache), stmt_(nullptr), aggregate_(aggregate) {
+	where_clause_ = WhereClause(predicate, parameters_);
 }
 
-int64_t FetchMaxIdQuery::GetMaxId() {
-	const auto sql = PrepareSql();
+FetchAggregateQuery::~FetchAggregateQuery() {
+	ReleaseStatement(sql_, stmt_);
+}
 
-	if (sqlite3_prepare_v2(db_, sql.data(), -1, &stmt_, nullptr)) {
-		sqlite3_close(db_);
-		throw std::runtime_error("Could not retrieve max id for table " + record_.name);
+std::string FetchAggregateQuery::PrepareSql() const {
+	return "SELECT " + aggregate_ + " FROM " + record_.name + where_clause_ + ";";
+}
+
+void FetchAggregateQuery::GetResult(void* p, const SqliteStorageClass storage_class) {
+	sql_ = PrepareSql();
+	stmt_ = AcquireStatement(sql_);
+
+	if (stmt_ == nullptr) {
+		throw std::runtime_error("Could not retrieve " + aggregate_ + " for table " + record_.name);
 	}
 
 	const auto column_count = sqlite3_column_count(stmt_);
 	if (column_count != 1) {
-		throw std::runtime_error("Number of columns for max id is wrong for table " + record_.name);
+		throw std::runtime_error("Number of columns for " + aggregate_ + " is wrong for table " + record_.name);
 	}
 
+	const StatementReset reset(stmt_);
+	BindParameters(stmt_, parameters_);
 	if (sqlite3_step(stmt_) != SQLITE_ROW) {
-		throw std::runtime_error("Row result could not be read for max id of table " + record_.name);
+		throw std::runtime_error("Row result could not be read for " + aggregate_ + " of table " + record_.name);
 	}
 
-	const auto max_id = sqlite3_column_int(stmt_, 0);
+	ReadColumnValue(stmt_, 0, p, storage_class);
+}
+
+FetchMaxIdQuery::FetchMaxIdQuery(sqlite3* db, const Reflection& record)
+	: FetchAggregateQuery(db, record, "MAX(id)", nullptr) {}
+
+int64_t FetchMaxIdQuery::GetMaxId() {
+	int64_t max_id = 0;
+	GetResult(&max_id, SqliteStorageClass::kInt);
 	return max_id;
 }
 
-FetchRecordsQuery::FetchRecordsQuery(sqlite3* db, const Reflection& record, const QueryPredicateBase* predicate)
-	: Query(db, record), stmt_(nullptr), predicate_(predicate) {}
+ExistsQuery::ExistsQuery(sqlite3* db, const Reflection& record, const QueryPredicateBase* predicate, StatementCache* cache)
+	: FetchAggregateQuery(db, record, "EXISTS", predicate, cache) {}
 
-FetchRecordsQuery::~FetchRecordsQuery() {
-	if (stmt_) {
-		sqlite3_finalize(stmt_);
-	}
+std::string ExistsQuery::PrepareSql() const {
+	return "SELECT EXISTS(SELECT 1 FROM " + record_.name + where_clause_ + " LIMIT 1);";
 }
 
-FetchQueryResults FetchRecordsQuery::GetResults() {
-	const auto sql = PrepareSql();
+bool ExistsQuery::Exists() {
+	auto exists = false;
+	GetResult(&exists, SqliteStorageClass::kBool);
+	return exists;
+}
 
-	if (sqlite3_prepare_v2(db_, sql.data(), -1, &stmt_, nullptr)) {
-		sqlite3_close(db_);
-		throw std::runtime_error((sql + ": could not get results").data());
+FetchGroupedQuery::FetchGroupedQuery(sqlite3* db, const Reflection& record, const std::string& group_column,
+                                     const std::vector<std::string>& aggregates, const QueryPredicateBase* predicate,
+                                     StatementCache* cache)
+	: Query(db, record, cache), stmt_(nullptr), group_column_(group_column), aggregates_(aggregates) {
+	where_clause_ = WhereClause(predicate, parameters_);
+}
+
+FetchGroupedQuery::~FetchGroupedQuery() {
+	ReleaseStatement(sql_, stmt_);
+}
+
+std::string FetchGroupedQuery::PrepareSql() const {
+	std::vector<std::string> columns;
+	columns.reserve(aggregates_.size() + 1);
+	columns.emplace_back(group_column_);
+	columns.insert(columns.end(), aggregates_.begin(), aggregates_.end());
+
+	std::string sql("SELECT ");
+	sql += StringUtilities::Join(columns, ", ") + " FROM " + record_.name + where_clause_;
+	sql += " GROUP BY " + group_column_ + " ORDER BY " + group_column_ + ";";
+	return sql;
+}
+
+void FetchGroupedQuery::GetResults(const std::vector<SqliteStorageClass>& storage_classes, const std::function<std::vector<void*>()>& next_row) {
+	sql_ = PrepareSql();
+	stmt_ = AcquireStatement(sql_);
+
+	if (stmt_ == nullptr) {
+		throw std::runtime_error((sql_ + ": could not get results").data());
 	}
 
 	const auto column_count = sqlite3_column_count(stmt_);
-
-	FetchQueryResults results;
-	results.column_names.reserve(column_count);
-	for (auto i = 0; i < column_count; i++) {
-		results.column_names.emplace_back(sqlite3_column_name(stmt_, i));
+	if (column_count != storage_classes.size()) {
+		throw std::runtime_error("Number of columns for grouped aggregates is wrong for table " + record_.name);
 	}
 
-	while (sqlite3_step(stmt_) != SQLITE_DONE) {
-		std::vector<std::wstring> row;
-		row.reserve(column_count);
-		for (auto col = 0; col < column_count; col++) {
-			auto value = GetColumnValue(col);
-			row.emplace_back(value);
+	auto result = SQLITE_DONE;
+	{
+		const StatementReset reset(stmt_);
+		BindParameters(stmt_, parameters_);
+		result = sqlite3_step(stmt_);
+		while (result == SQLITE_ROW) {
+			const auto addresses = next_row();
+			for (auto col = 0; col < column_count; col++) {
+				ReadColumnValue(stmt_, col, addresses[col], storage_classes[col]);
+			}
+			result = sqlite3_step(stmt_);
 		}
-		results.row_values.emplace_back(row);
 	}
 
-	return results;
+	if (result != SQLITE_DONE) {
+		throw std::runtime_error((sql_ + ": could not get results").data());
+	}
+}
+
+FetchRecordsQuery::FetchRecordsQuery(sqlite3* db, const Reflection& record, const QueryPredicateBase* predicate,
+                                     const OrderBy* order_by, int64_t limit, StatementCache* cache)
+	: Query(db, record, cache), stmt_(nullptr), limit_(limit) {
+	where_clause_ = WhereClause(predicate, parameters_);
+	if (order_by != nullptr) {
+		order_by_clause_ = " ORDER BY " + order_by->Evaluate();
+	}
+}
+
+FetchRecordsQuery::~FetchRecordsQuery() {
+	ReleaseStatement(sql_, stmt_);
 }
 
-void FetchRecordsQuery::Hydrate(void* p, const FetchQueryResults& query_results, const Reflection& record, size_t i) {
-	for (auto j = 0; j < query_results.column_names.size(); j++) {
-		const auto current_column = query_results.column_names[j];
-		const auto current_storage_class = record.member_metadata[j].storage_class;
-		const auto& content = query_results.row_values[i][j];
-		if (content == L"") {
-			continue;
+size_t FetchRecordsQuery::GetResults(const std::function<void*()>& next_record, uint64_t* bytes) {
+	if (stmt_ == nullptr) {
+		sql_ = PrepareSql();
+		stmt_ = AcquireStatement(sql_);
+		if (stmt_ == nullptr) {
+			throw std::runtime_error((sql_ + ": could not get results").data());
 		}
+	}
 
-		switch (current_storage_class) {
-		case SqliteStorageClass::kInt:
-			{
-				auto& v = (*(int64_t*)((void*)GetMemberAddress(p, record, j)));
-				v = StringUtilities::ToInt(content);
-				break;
-			}
-                
-        case SqliteStorageClass::kBool:
-            {
-                auto& v = (*(bool*)((void*)GetMemberAddress(p, record, j)));
-                v = StringUtilities::ToInt(content) == 1;
-                break;
-            }
+	const auto& members = record_.member_metadata;
+	const auto column_count = sqlite3_column_count(stmt_);
+	if (column_count != members.size()) {
+		throw std::runtime_error("Number of columns is wrong for table " + record_.name);
+	}
 
-		case SqliteStorageClass::kReal:
-			{
-				auto& v = (*(double*)((void*)GetMemberAddress(p, record, j)));
-				v = StringUtilities::ToDouble(content);
-				break;
+	size_t records = 0;
+	auto result = SQLITE_DONE;
+	{
+		const StatementReset reset(stmt_);
+		BindParameters(stmt_, parameters_);
+		// the limit follows all other placeholders, and a negative value lets SQLite return every row
+		sqlite3_bind_int64(stmt_, static_cast<int>(parameters_.size()) + 1, limit_);
+		result = sqlite3_step(stmt_);
+		while (result == SQLITE_ROW) {
+			const auto p = next_record();
+			for (auto col = 0; col < column_count; col++) {
+				ReadColumnValue(stmt_, col, GetMemberAddress(p, record_, col), members[col].storage_class);
+				if (bytes != nullptr) {
+					const auto column_type = sqlite3_column_type(stmt_, col);
+					*bytes += column_type == SQLITE_TEXT || column_type == SQLITE_BLOB
+						          ? sqlite3_column_bytes(stmt_, col)
+						          : sizeof(int64_t);
+				}
 			}
+			++records;
+			result = sqlite3_step(stmt_);
+		}
+	}
 
-		case SqliteStorageClass::kText:
-			{
-				auto& v = (*(std::wstring*)((void*)GetMemberAddress(p, record, j)));
-				v = content;
-				break;
-			}
+	if (result != SQLITE_DONE) {
+		throw std::runtime_error((sql_ + ": could not get results").data());
+	}
 
-		case SqliteStorageClass::kDateTime:
-			{
-				auto& v = (*(TimePoint*)((void*)GetMemberAddress(p, record, j)));
-				v = TimePoint::FromSystemTime(content);
-				break;
+	return records;
+}
+
+void FetchRecordsQuery::Bind(const size_t index, const QueryParameter& parameter) {
+	if (index >= parameters_.size()) {
+		throw std::out_of_range("There is no placeholder with this index in the fetch query for table " + record_.name);
+	}
+	parameters_[index] = parameter;
+}
+
+void FetchRecordsQuery::Bind(const QueryPredicateBase* predicate) {
+	std::vector<QueryParameter> parameters;
+	const auto where_clause = WhereClause(predicate, parameters);
+	if (where_clause != where_clause_) {
+		throw std::invalid_argument("The predicate does not match the shape of the prepared fetch query for table " + record_.name);
+	}
+	parameters_ = parameters;
+}
+
+SearchRecordsQuery::SearchRecordsQuery(sqlite3* db, const Reflection& record, const std::string& member_name,
+                                       const QueryParameter& search_query, int64_t limit, StatementCache* cache)
+	: FetchRecordsQuery(db, record, nullptr, nullptr, limit, cache), member_name_(member_name) {
+	parameters_.push_back(search_query);
+}
+
+std::string SearchRecordsQuery::PrepareSql() const {
+	const auto fts_table = FullTextSearchTableName(record_);
+	std::vector<std::string> columns;
+	columns.reserve(record_.member_metadata.size());
+	for (const auto& member : record_.member_metadata) {
+		columns.emplace_back(record_.name + "." + member.name);
+	}
+
+	std::string sql("SELECT ");
+	sql += StringUtilities::Join(columns, ", ") + " FROM " + record_.name + " JOIN " + fts_table + " ON " + fts_table + ".rowid = " + record_.name + ".id";
+	sql += " WHERE " + fts_table + "." + member_name_ + " MATCH ? ORDER BY " + fts_table + ".rank";
+	sql += " LIMIT ?";
+	sql += ";";
+	return sql;
+}
+
+std::string FetchRecordsQuery::PrepareSql() const {
+	std::string sql("SELECT ");
+	sql += JoinedRecordColumnNames() + " FROM " + record_.name + where_clause_ + order_by_clause_;
+	sql += " LIMIT ?";
+	return sql + ";";
+}
+
+JoinRecordsQuery::JoinRecordsQuery(sqlite3* db, const Reflection& record, const std::string& member_name, const QueryPredicateBase* predicate,
+                                   const Reflection& joined_record, const std::string& joined_member_name, const QueryPredicateBase* joined_predicate,
+                                   StatementCache* cache)
+	: Query(db, record, cache), member_name_(member_name), joined_record_(joined_record), joined_member_name_(joined_member_name) {
+	// the placeholders of both predicates are bound in order of appearance
+	where_clause_ = WhereClause(predicate, parameters_);
+	joined_where_clause_ = WhereClause(joined_predicate, parameters_);
+}
+
+/// Returns the table of a record, or a subquery restricting it to a given WHERE clause
+static std::string JoinSource(const Reflection& record, const std::string& where_clause) {
+	return where_clause.empty()
+		       ? record.name
+		       : "(SELECT * FROM " + record.name + where_clause + ")";
+}
+
+std::string JoinRecordsQuery::PrepareSql() const {
+	std::vector<std::string> columns;
+	columns.reserve(record_.member_metadata.size() + joined_record_.member_metadata.size());
+	for (const auto& member : record_.member_metadata) {
+		columns.emplace_back("lhs." + member.name);
+	}
+	for (const auto& member : joined_record_.member_metadata) {
+		columns.emplace_back("rhs." + member.name);
+	}
+
+	std::string sql("SELECT ");
+	sql += StringUtilities::Join(columns, ", ");
+	sql += " FROM " + JoinSource(record_, where_clause_) + " AS lhs";
+	sql += " JOIN " + JoinSource(joined_record_, joined_where_clause_) + " AS rhs";
+	sql += " ON lhs." + member_name_ + " = rhs." + joined_member_name_ + ";";
+	return sql;
+}
+
+size_t JoinRecordsQuery::GetResults(const std::function<std::pair<void*, void*>()>& next_row) const {
+	const auto sql = PrepareSql();
+	const auto stmt = AcquireStatement(sql);
+	if (stmt == nullptr) {
+		throw std::runtime_error((sql + ": could not get results").data());
+	}
+
+	const auto& members = record_.member_metadata;
+	const auto& joined_members = joined_record_.member_metadata;
+	const auto column_count = (int)members.size();
+
+	size_t rows = 0;
+	auto result = SQLITE_DONE;
+	try {
+		BindParameters(stmt, parameters_);
+		result = sqlite3_step(stmt);
+		while (result == SQLITE_ROW) {
+			const auto row = next_row();
+			for (auto col = 0; col < column_count; col++) {
+				ReadColumnValue(stmt, col, GetMemberAddress(row.first, record_, col), members[col].storage_class);
+			}
+			for (auto col = 0; col < (int)joined_members.size(); col++) {
+				ReadColumnValue(stmt, column_count + col, GetMemberAddress(row.second, joined_record_, col), joined_members[col].storage_class);
 			}
+			++rows;
+			result = sqlite3_step(stmt);
+		}
+	}
+	catch (...) {
+		ReleaseStatement(sql, stmt);
+		throw;
+	}
+	ReleaseStatement(sql, stmt);
 
-		default:
-			break;
+	if (result != SQLITE_DONE) {
+		throw std::runtime_error((sql + ": could not get results").data());
+	}
+	return rows;
+}
+
+Cursor::Cursor(sqlite3* db, const std::string& sql, const std::vector<QueryParameter>& parameters, StatementCache* cache)
+	: Query(db, NoRecord(), cache), sql_(sql), parameters_(parameters), stmt_(nullptr), read_record_(nullptr) {
+	stmt_ = AcquireStatement(sql_);
+	if (stmt_ == nullptr) {
+		throw std::runtime_error(sql_ + ": " + sqlite3_errmsg(db_));
+	}
+	if ((size_t)sqlite3_bind_parameter_count(stmt_) != parameters_.size()) {
+		ReleaseStatement(sql_, stmt_);
+		throw std::invalid_argument(sql_ + ": the number of parameters does not match the number of placeholders");
+	}
+	BindParameters(stmt_, parameters_);
+}
+
+Cursor::Cursor(Cursor&& other) noexcept
+	: Query(other), sql_(std::move(other.sql_)), parameters_(std::move(other.parameters_)), stmt_(other.stmt_),
+	  read_record_(other.read_record_), read_members_(std::move(other.read_members_)) {
+	other.stmt_ = nullptr;
+}
+
+Cursor& Cursor::operator=(Cursor&& other) noexcept {
+	if (this != &other) {
+		if (stmt_ != nullptr) {
+			ReleaseStatement(sql_, stmt_);
 		}
+		// all cursors share the same empty record, so only the connection and the statement cache are taken over
+		db_ = other.db_;
+		cache_ = other.cache_;
+		sql_ = std::move(other.sql_);
+		parameters_ = std::move(other.parameters_);
+		stmt_ = other.stmt_;
+		read_record_ = other.read_record_;
+		read_members_ = std::move(other.read_members_);
+		other.stmt_ = nullptr;
 	}
+	return *this;
 }
 
-std::string FetchRecordsQuery::PrepareSql() const {
-	std::string sql("SELECT * FROM ");
-	sql += record_.name;
-	const auto condition_evaluation = predicate_->Evaluate();
-	if (strcmp(condition_evaluation.data(), "") != 0) {
-		sql += " WHERE " + condition_evaluation;
+Cursor::~Cursor() {
+	if (stmt_ != nullptr) {
+		ReleaseStatement(sql_, stmt_);
 	}
-	return sql + ";";
 }
 
-std::wstring FetchRecordsQuery::GetColumnValue(const int col) const {
-	const int col_type = sqlite3_column_type(stmt_, col);
-	switch (col_type) {
-	case SQLITE_INTEGER:
-		return std::to_wstring(sqlite3_column_int(stmt_, col));
+std::string Cursor::PrepareSql() const {
+	return sql_;
+}
 
-	case SQLITE_FLOAT:
-		return std::to_wstring(sqlite3_column_double(stmt_, col));
+bool Cursor::Next() {
+	const auto result = sqlite3_step(stmt_);
+	if (result == SQLITE_ROW) {
+		return true;
+	}
+	if (result != SQLITE_DONE) {
+		throw std::runtime_error(sql_ + ": " + sqlite3_errmsg(db_));
+	}
+	return false;
+}
 
-	case SQLITE_TEXT:
-		{
-			const auto content = reinterpret_cast<const char*>(sqlite3_column_text(stmt_, col));
-			return StringUtilities::FromUtf8(content);
+int Cursor::ColumnCount() const {
+	return sqlite3_column_count(stmt_);
+}
+
+std::string Cursor::ColumnName(const int col) const {
+	return sqlite3_column_name(stmt_, col);
+}
+
+bool Cursor::IsNull(const int col) const {
+	return sqlite3_column_type(stmt_, col) == SQLITE_NULL;
+}
+
+int64_t Cursor::GetInt64(const int col) const {
+	return sqlite3_column_int64(stmt_, col);
+}
+
+double Cursor::GetDouble(const int col) const {
+	return sqlite3_column_double(stmt_, col);
+}
+
+std::string Cursor::GetText(const int col) const {
+	std::string value;
+	ReadColumnValue(stmt_, col, &value, SqliteStorageClass::kUtf8Text);
+	return value;
+}
+
+std::wstring Cursor::GetWideText(const int col) const {
+	std::wstring value;
+	ReadColumnValue(stmt_, col, &value, SqliteStorageClass::kText);
+	return value;
+}
+
+std::vector<uint8_t> Cursor::GetBlob(const int col) const {
+	std::vector<uint8_t> value;
+	ReadColumnValue(stmt_, col, &value, SqliteStorageClass::kBlob);
+	return value;
+}
+
+void Cursor::Read(void* p, const Reflection& record) {
+	const auto column_count = ColumnCount();
+	if (read_record_ != &record) {
+		read_record_ = &record;
+		read_members_.assign(column_count, -1);
+		for (auto col = 0; col < column_count; col++) {
+			const auto column_name = ColumnName(col);
+			for (size_t i = 0; i < record.member_metadata.size(); i++) {
+				if (record.member_metadata[i].name == column_name) {
+					read_members_[col] = (int)i;
+					break;
+				}
+			}
 		}
+	}
 
-	default:
-		return L"";
+	for (auto col = 0; col < column_count; col++) {
+		const auto i = read_members_[col];
+		if (i >= 0) {
+			ReadColumnValue(stmt_, col, GetMemberAddress(p, record, i), record.member_metadata[i].storage_class);
+		}
 	}
 }
@@ -0,0 +1,39 @@
+// MIT License
+//
+// Copyright (c) 2023 Ioannis Kaliakatsos
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "query_ordering.h"
+#include "internal/string_utilities.h"
+
+using namespace sqlite_reflection;
+
+std::string OrderBy::Evaluate() const {
+	std::vector<std::string> terms;
+	terms.reserve(terms_.size());
+	for (const auto& term : terms_) {
+		terms.emplace_back(term.first + (term.second == Direction::kDescending ? " DESC" : " ASC"));
+	}
+	return StringUtilities::Join(terms, ", ");
+}
+
+void OrderBy::Append(const std::string& member_name, Direction direction) {
+	terms_.emplace_back(member_name, direction);
+}
@@ -22,6 +22,12 @@
 
 #include "query_predicates.h"
 #include "internal/string_utilities.h"
+#include "internal/packed_arrays.h"
+#include "internal/text_compression.h"
+
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
 
 using namespace sqlite_reflection;
 
@@ -29,14 +35,139 @@ const std::string single_quote("'");
 const std::string space(" ");
 const std::string percent("%");
 
+/// The maximum number of control values of a membership predicate, which are bound with one placeholder each.
+/// Longer lists of scalar values are bound as a single JSON array, so that lists of any length share one statement
+const size_t max_listed_values = 16;
+
+/// The maximum number of control values of a membership predicate on binary values, which cannot be bound as JSON.
+/// Such lists are padded to the next power of two, which keeps the number of distinct statements logarithmic,
+/// and need to stay well below the limit of 32766 host parameters per statement of SQLite 3.32 and later
+const size_t max_bound_values = 16384;
+
+/// The largest unicode code point and the range reserved for UTF-16 surrogates
+const wchar_t max_code_point = (wchar_t)(sizeof(wchar_t) > 2 ? 0x10FFFF : 0xFFFF);
+const wchar_t surrogate_start = 0xD800;
+const wchar_t surrogate_end = 0xDFFF;
+
+QueryParameter QueryParameter::FromValue(void* v, SqliteStorageClass storage_class) {
+	QueryParameter parameter;
+	parameter.storage_class = storage_class;
+	parameter.int_value = 0;
+	parameter.real_value = 0.0;
+
+	switch (storage_class) {
+	case SqliteStorageClass::kInt:
+		parameter.int_value = *(int64_t*)(v);
+		break;
+	case SqliteStorageClass::kBool:
+		parameter.int_value = *(bool*)(v) ? 1 : 0;
+		break;
+	case SqliteStorageClass::kReal:
+		parameter.real_value = *(double*)(v);
+		break;
+	case SqliteStorageClass::kText:
+		parameter.text_value = StringUtilities::ToUtf8(*(std::wstring*)(v));
+		break;
+	case SqliteStorageClass::kUtf8Text:
+		parameter.text_value = *(std::string*)(v);
+		break;
+	case SqliteStorageClass::kBlob:
+		{
+			const auto& blob = *(std::vector<uint8_t>*)(v);
+			parameter.text_value.assign(blob.begin(), blob.end());
+			break;
+		}
+	case SqliteStorageClass::kRealArray:
+		parameter.text_value = PackedArrays::Pack(*(std::vector<double>*)(v));
+		break;
+	case SqliteStorageClass::kIntArray:
+		parameter.text_value = PackedArrays::Pack(*(std::vector<int64_t>*)(v));
+		break;
+	case SqliteStorageClass::kIntArrayDelta:
+		parameter.text_value = PackedArrays::PackDeltas(*(std::vector<int64_t>*)(v));
+		break;
+	case SqliteStorageClass::kCompressedText:
+		parameter.text_value = TextCompression::Compress(StringUtilities::ToUtf8(*(std::wstring*)(v)));
+		break;
+	case SqliteStorageClass::kDateTime:
+		parameter.text_value = StringUtilities::ToUtf8((*(TimePoint*)(v)).SystemTime());
+		break;
+	default:
+		throw std::domain_error("Blob cannot be compared against equality");
+	}
+	return parameter;
+}
+
+QueryParameter QueryParameter::FromText(const std::string& utf8_text) {
+	QueryParameter parameter;
+	parameter.storage_class = SqliteStorageClass::kText;
+	parameter.int_value = 0;
+	parameter.real_value = 0.0;
+	parameter.text_value = utf8_text;
+	return parameter;
+}
+
+std::string QueryParameter::ToSql() const {
+	switch (storage_class) {
+	case SqliteStorageClass::kText:
+	case SqliteStorageClass::kUtf8Text:
+	case SqliteStorageClass::kDateTime:
+		{
+			std::string escaped;
+			escaped.reserve(text_value.length() + 2);
+			escaped += single_quote;
+			for (const auto c : text_value) {
+				escaped += c;
+				if (c == '\'') {
+					escaped += c;
+				}
+			}
+			return escaped + single_quote;
+		}
+	case SqliteStorageClass::kBlob:
+	case SqliteStorageClass::kRealArray:
+	case SqliteStorageClass::kIntArray:
+	case SqliteStorageClass::kIntArrayDelta:
+	case SqliteStorageClass::kCompressedText:
+		{
+			static const char* hex_digits = "0123456789ABCDEF";
+			std::string literal("X'");
+			literal.reserve(text_value.length() * 2 + 3);
+			for (const auto c : text_value) {
+				literal += hex_digits[(uint8_t)c >> 4];
+				literal += hex_digits[(uint8_t)c & 0x0F];
+			}
+			return literal + single_quote;
+		}
+	default:
+		return ToText();
+	}
+}
+
+std::string QueryParameter::ToText() const {
+	switch (storage_class) {
+	case SqliteStorageClass::kInt:
+	case SqliteStorageClass::kBool:
+		return StringUtilities::FromInt(int_value);
+	case SqliteStorageClass::kReal:
+		return StringUtilities::FromDouble(real_value);
+	default:
+		return text_value;
+	}
+}
+
 QueryPredicateBase* QueryPredicate::Clone() const {
-	return new QueryPredicate(symbol_, member_name_, value_);
+	return new QueryPredicate(symbol_, member_name_, placeholder_, parameters_);
 }
 
 std::string EmptyPredicate::Evaluate() const {
 	return "";
 }
 
+std::string EmptyPredicate::Evaluate(std::vector<QueryParameter>& parameters) const {
+	return "";
+}
+
 QueryPredicateBase* EmptyPredicate::Clone() const {
 	return new EmptyPredicate();
 }
@@ -50,55 +181,245 @@ OrPredicate QueryPredicateBase::Or(const QueryPredicateBase& other) const {
 }
 
 std::string QueryPredicate::Evaluate() const {
-	return member_name_ + space + symbol_ + space + value_;
+	std::string value;
+	value.reserve(placeholder_.length());
+	size_t parameter_index = 0;
+	for (const auto c : placeholder_) {
+		if (c == '?' && parameter_index < parameters_.size()) {
+			value += parameters_[parameter_index++].ToSql();
+		} else {
+			value += c;
+		}
+	}
+	return member_name_ + space + symbol_ + space + value;
 }
 
-std::string QueryPredicate::GetStringForValue(void* v, SqliteStorageClass storage_class) const {
+std::string QueryPredicate::Evaluate(std::vector<QueryParameter>& parameters) const {
+	parameters.insert(parameters.end(), parameters_.begin(), parameters_.end());
+	return member_name_ + space + symbol_ + space + placeholder_;
+}
+
+QueryParameter Like::Pattern(const QueryParameter& value) {
+	switch (value.storage_class) {
+	case SqliteStorageClass::kBlob:
+	case SqliteStorageClass::kRealArray:
+	case SqliteStorageClass::kIntArray:
+	case SqliteStorageClass::kIntArrayDelta:
+	case SqliteStorageClass::kCompressedText:
+		throw std::domain_error("Binary and compressed members cannot be matched against a pattern");
+	default:
+		break;
+	}
+	return QueryParameter::FromText(percent + value.ToText() + percent);
+}
+
+const std::string& TextPattern::PatternMemberName(const Reflection::MemberMetadata& member) {
+	if (member.storage_class == SqliteStorageClass::kCompressedText) {
+		throw std::domain_error("Compressed member " + member.name + " cannot be matched against a text pattern");
+	}
+	return member.name;
+}
+
+QueryParameter TextPattern::Pattern(const std::wstring& value, const bool case_sensitive, const bool any_prefix, const bool any_suffix) {
+	return Pattern(StringUtilities::ToUtf8(value), case_sensitive, any_prefix, any_suffix);
+}
+
+QueryParameter TextPattern::Pattern(const std::string& utf8_value, const bool case_sensitive, const bool any_prefix, const bool any_suffix) {
+	const auto wildcard = case_sensitive ? std::string("*") : percent;
+	std::string pattern = any_prefix ? wildcard : "";
+	for (const auto c : utf8_value) {
+		if (case_sensitive && (c == '*' || c == '?' || c == '[')) {
+			pattern += '[';
+			pattern += c;
+			pattern += ']';
+		} else if (!case_sensitive && (c == '%' || c == '_' || c == '\\')) {
+			pattern += '\\';
+			pattern += c;
+		} else {
+			pattern += c;
+		}
+	}
+	if (any_suffix) {
+		pattern += wildcard;
+	}
+	return QueryParameter::FromText(pattern);
+}
+
+std::wstring StartsWith::UpperBound(const std::wstring& prefix) {
+	auto bound = prefix;
+	while (!bound.empty()) {
+		auto& last = bound.back();
+		if (last < max_code_point) {
+			// skip the UTF-16 surrogate range, which has no valid UTF-8 encoding
+			last = last == surrogate_start - 1 ? surrogate_end + 1 : last + 1;
+			break;
+		}
+		bound.pop_back();
+	}
+	return bound;
+}
+
+std::string StartsWith::Placeholder(const std::string& member_name, const std::wstring& value, const bool case_sensitive) {
+	if (!case_sensitive) {
+		return "? ESCAPE '\\'";
+	}
+	return UpperBound(value).empty()
+		       ? "?"
+		       : "? AND " + member_name + " < ?";
+}
+
+std::string StartsWith::UpperBound(const std::string& utf8_prefix) {
+	auto bound = utf8_prefix;
+	while (!bound.empty()) {
+		auto& last = bound.back();
+		if ((uint8_t)last < 0xFF) {
+			last = (char)((uint8_t)last + 1);
+			break;
+		}
+		bound.pop_back();
+	}
+	return bound;
+}
+
+std::string StartsWith::Placeholder(const std::string& member_name, const std::string& utf8_value, const bool case_sensitive) {
+	if (!case_sensitive) {
+		return "? ESCAPE '\\'";
+	}
+	return UpperBound(utf8_value).empty()
+		       ? "?"
+		       : "? AND " + member_name + " < ?";
+}
+
+std::vector<QueryParameter> StartsWith::Parameters(const std::string& utf8_value, const bool case_sensitive) {
+	if (!case_sensitive) {
+		return std::vector<QueryParameter>{Pattern(utf8_value, false, false, true)};
+	}
+
+	std::vector<QueryParameter> parameters{QueryParameter::FromText(utf8_value)};
+	const auto upper_bound = UpperBound(utf8_value);
+	if (!upper_bound.empty()) {
+		parameters.emplace_back(QueryParameter::FromText(upper_bound));
+	}
+	return parameters;
+}
+
+std::vector<QueryParameter> StartsWith::Parameters(const std::wstring& value, const bool case_sensitive) {
+	if (!case_sensitive) {
+		return std::vector<QueryParameter>{Pattern(value, false, false, true)};
+	}
+
+	std::vector<QueryParameter> parameters{QueryParameter::FromText(StringUtilities::ToUtf8(value))};
+	const auto upper_bound = UpperBound(value);
+	if (!upper_bound.empty()) {
+		parameters.emplace_back(QueryParameter::FromText(StringUtilities::ToUtf8(upper_bound)));
+	}
+	return parameters;
+}
+
+In::In(const Reflection::MemberMetadata& member, const std::vector<int64_t>& values)
+	: QueryPredicate("IN", member.name, "", std::vector<QueryParameter>()) {
+	parameters_.reserve(values.size());
+	for (const auto& value : values) {
+		parameters_.emplace_back(QueryParameter::FromValue((void*)&value, member.storage_class));
+	}
+	Enclose();
+}
+
+/// Whether values of the given storage class can be represented in JSON, and compared to the member as such
+static bool IsJsonScalar(const SqliteStorageClass storage_class) {
 	switch (storage_class) {
 	case SqliteStorageClass::kInt:
-		{
-			auto value = *(int64_t*)(v);
-			return StringUtilities::FromInt(value);
-		}
-    case SqliteStorageClass::kBool:
-        {
-            auto value = *(bool*)(v);
-            return StringUtilities::FromInt(value ? 1 : 0);
-        }
+	case SqliteStorageClass::kBool:
 	case SqliteStorageClass::kReal:
-		{
-			auto value = *(double*)(v);
-			return StringUtilities::FromDouble(value);
-		}
 	case SqliteStorageClass::kText:
-		{
-			auto value = *(std::wstring*)(v);
-			return single_quote + StringUtilities::ToUtf8(value) + single_quote;
-		}
+	case SqliteStorageClass::kUtf8Text:
 	case SqliteStorageClass::kDateTime:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/// Appends a scalar control value to a JSON array, where reals keep their full precision
+static void AppendJson(std::string& json, const QueryParameter& parameter) {
+	static const char* hex_digits = "0123456789abcdef";
+	switch (parameter.storage_class) {
+	case SqliteStorageClass::kInt:
+	case SqliteStorageClass::kBool:
+		json += StringUtilities::FromInt(parameter.int_value);
+		break;
+	case SqliteStorageClass::kReal:
 		{
-			auto value = *(TimePoint*)(v);
-			return single_quote + StringUtilities::ToUtf8(value.SystemTime()) + single_quote;
+			char buffer[32];
+			snprintf(buffer, sizeof(buffer), "%.17g", parameter.real_value);
+			json += buffer;
+			break;
 		}
 	default:
-		throw std::domain_error("Blob cannot be compared against equality");
+		json += '"';
+		for (const auto c : parameter.text_value) {
+			if (c == '"' || c == '\\') {
+				json += '\\';
+				json += c;
+			} else if ((uint8_t)c < 0x20) {
+				json += "\\u00";
+				json += hex_digits[(uint8_t)c >> 4];
+				json += hex_digits[(uint8_t)c & 0x0F];
+			} else {
+				json += c;
+			}
+		}
+		json += '"';
+		break;
 	}
 }
 
-std::string Like::GetStringForValue(void* v, SqliteStorageClass storage_class) const {
-	auto value = QueryPredicate::GetStringForValue(v, storage_class);
-	value = Remove(value, single_quote);
-	return single_quote + percent + value + percent + single_quote;
+void In::Enclose() {
+	const auto storage_class = parameters_.empty() ? SqliteStorageClass::kInt : parameters_[0].storage_class;
+	auto json_values = parameters_.size() > max_listed_values && IsJsonScalar(storage_class);
+	if (json_values && storage_class == SqliteStorageClass::kReal) {
+		// JSON has no representation for infinities and NaN
+		for (const auto& parameter : parameters_) {
+			json_values = json_values && std::isfinite(parameter.real_value);
+		}
+	}
+
+	if (json_values) {
+		std::string json("[");
+		for (size_t i = 0; i < parameters_.size(); ++i) {
+			if (i > 0) {
+				json += ',';
+			}
+			AppendJson(json, parameters_[i]);
+		}
+		json += ']';
+		parameters_ = std::vector<QueryParameter>{QueryParameter::FromText(json)};
+		placeholder_ = "(SELECT value FROM json_each(?))";
+		return;
+	}
+
+	if (parameters_.size() > max_listed_values) {
+		if (parameters_.size() > max_bound_values) {
+			throw std::invalid_argument("A membership predicate on member " + member_name_ + " can have at most "
+				+ StringUtilities::FromInt((int64_t)max_bound_values) + " values of this type");
+		}
+		// repeating the last value does not change the result, but lets lists of similar length share a statement
+		size_t padded_size = max_listed_values;
+		while (padded_size < parameters_.size()) {
+			padded_size *= 2;
+		}
+		parameters_.resize(padded_size, parameters_.back());
+	}
+
+	const std::vector<std::string> placeholders(parameters_.size(), "?");
+	placeholder_ = "(" + StringUtilities::Join(placeholders, ", ") + ")";
 }
 
-std::string Like::Remove(const std::string& source, const std::string& substring) {
-	auto copy = source;
-	auto it = copy.find(substring);
-	while (it != std::string::npos) {
-		copy.erase(it, substring.length());
-		it = copy.find(substring);
+std::string Match::Subquery(const Reflection& record, const Reflection::MemberMetadata& member) {
+	if (!member.full_text_search) {
+		throw std::invalid_argument("Member " + member.name + " of record " + record.name + " is not indexed for full-text search");
 	}
-	return copy;
+	return "(SELECT rowid FROM " + FullTextSearchTableName(record) + " WHERE " + member.name + " MATCH ?)";
 }
 
 BinaryPredicate::BinaryPredicate(const QueryPredicateBase& left, const QueryPredicateBase& right, const std::string& symbol)
@@ -108,6 +429,12 @@ std::string BinaryPredicate::Evaluate() const {
 	return "(" + left_->Evaluate() + space + symbol_ + space + right_->Evaluate() + ")";
 }
 
+std::string BinaryPredicate::Evaluate(std::vector<QueryParameter>& parameters) const {
+	const auto left = left_->Evaluate(parameters);
+	const auto right = right_->Evaluate(parameters);
+	return "(" + left + space + symbol_ + space + right + ")";
+}
+
 AndPredicate::AndPredicate(const QueryPredicateBase& left, const QueryPredicateBase& right)
 	: BinaryPredicate(left, right, "AND") {}
 
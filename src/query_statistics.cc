@@ -0,0 +1,167 @@
+// MIT License
+//
+// Copyright (c) 2023 Ioannis Kaliakatsos
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "query_statistics.h"
+
+#include <cmath>
+
+#include "internal/sqlite3.h"
+
+using namespace sqlite_reflection;
+
+/// Forwards the latency of every completed statement of the connection to its instrumentation
+static int TraceStatement(unsigned type, void* context, void* p, void* x) {
+	if (type != SQLITE_TRACE_PROFILE) {
+		return 0;
+	}
+	const auto instrumentation = static_cast<Instrumentation*>(context);
+	const auto stmt = static_cast<sqlite3_stmt*>(p);
+	const auto nanoseconds = *static_cast<sqlite3_int64*>(x);
+
+	if (!instrumentation->RecordStatement((uint64_t)nanoseconds)) {
+		return 0;
+	}
+
+	// only slow statements are expanded with their bound values, since this allocates a copy of the SQL
+	const auto expanded_sql = sqlite3_expanded_sql(stmt);
+	instrumentation->RecordSlowQuery(expanded_sql != nullptr ? expanded_sql : sqlite3_sql(stmt), (uint64_t)nanoseconds);
+	sqlite3_free(expanded_sql);
+	return 0;
+}
+
+LatencyHistogram::LatencyHistogram()
+	: count_(0), total_nanoseconds_(0) {
+	buckets_.fill(0);
+}
+
+void LatencyHistogram::Record(uint64_t nanoseconds) {
+	size_t bucket = 0;
+	while (nanoseconds >> (bucket + 1) && bucket < buckets_.size() - 1) {
+		bucket++;
+	}
+	buckets_[bucket]++;
+	count_++;
+	total_nanoseconds_ += nanoseconds;
+}
+
+uint64_t LatencyHistogram::Count() const {
+	return count_;
+}
+
+double LatencyHistogram::TotalMicroseconds() const {
+	return total_nanoseconds_ / 1000.0;
+}
+
+double LatencyHistogram::Percentile(double percentile) const {
+	if (count_ == 0) {
+		return 0.0;
+	}
+
+	const auto rank = (uint64_t)std::ceil(percentile / 100.0 * count_);
+	uint64_t cumulative_count = 0;
+	for (auto i = 0; i < buckets_.size(); ++i) {
+		cumulative_count += buckets_[i];
+		if (cumulative_count >= rank) {
+			return std::ldexp(1.0, i + 1) / 1000.0;
+		}
+	}
+	return std::ldexp(1.0, (int)buckets_.size()) / 1000.0;
+}
+
+double LatencyHistogram::P50() const {
+	return Percentile(50.0);
+}
+
+double LatencyHistogram::P99() const {
+	return Percentile(99.0);
+}
+
+Instrumentation::Instrumentation(sqlite3* db, double slow_query_threshold_milliseconds, size_t max_slow_queries)
+	: db_(db), slow_query_threshold_nanoseconds_((uint64_t)(slow_query_threshold_milliseconds * 1e6)), max_slow_queries_(max_slow_queries) {
+	sqlite3_trace_v2(db_, SQLITE_TRACE_PROFILE, TraceStatement, this);
+}
+
+Instrumentation::~Instrumentation() {
+	sqlite3_trace_v2(db_, 0, nullptr, nullptr);
+}
+
+void Instrumentation::RecordOperation(const std::string& record_name, const char* operation, Clock::time_point start, uint64_t rows, uint64_t bytes) {
+	const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto& statistics = statistics_.operations[std::make_pair(record_name, std::string(operation))];
+	statistics.latency.Record((uint64_t)nanoseconds);
+	statistics.rows += rows;
+	statistics.bytes += bytes;
+}
+
+bool Instrumentation::RecordStatement(uint64_t nanoseconds) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		statistics_.statements.Record(nanoseconds);
+	}
+	return nanoseconds >= slow_query_threshold_nanoseconds_ && max_slow_queries_ > 0;
+}
+
+void Instrumentation::RecordSlowQuery(const std::string& sql, uint64_t nanoseconds) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto& slow_queries = statistics_.slow_queries;
+	if (slow_queries.size() == max_slow_queries_) {
+		slow_queries.erase(slow_queries.begin());
+	}
+	slow_queries.push_back(SlowQuery{sql, "", nanoseconds / 1e6});
+}
+
+DatabaseStatistics Instrumentation::Snapshot() const {
+	DatabaseStatistics statistics;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		statistics = statistics_;
+	}
+
+	// the query plans are retrieved without holding the lock, since their own execution is traced as well
+	for (auto& slow_query : statistics.slow_queries) {
+		slow_query.query_plan = QueryPlan(slow_query.sql);
+	}
+	return statistics;
+}
+
+std::string Instrumentation::QueryPlan(const std::string& sql) const {
+	const auto explain_sql = "EXPLAIN QUERY PLAN " + sql;
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db_, explain_sql.data(), -1, &stmt, nullptr)) {
+		sqlite3_finalize(stmt);
+		return "";
+	}
+
+	std::string query_plan;
+	while (sqlite3_step(stmt) == SQLITE_ROW) {
+		// each row describes a single plan step: id, parent, notused, detail
+		const auto detail = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+		if (!query_plan.empty()) {
+			query_plan += "\n";
+		}
+		query_plan += detail != nullptr ? detail : "";
+	}
+	sqlite3_finalize(stmt);
+	return query_plan;
+}
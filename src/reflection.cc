@@ -43,3 +43,52 @@ char* GetMemberAddress(void* precord, const Reflection& record, const size_t i)
 	const size_t var_offset = record.member_metadata[i].offset;
 	return struct_start + var_offset;
 }
+
+bool HasFullTextSearch(const Reflection& record) {
+	for (const auto& member : record.member_metadata) {
+		if (member.full_text_search) {
+			return true;
+		}
+	}
+	return false;
+}
+
+const Reflection::MemberMetadata& ReferenceMember(const Reflection& record, const Reflection& referenced_record) {
+	const Reflection::MemberMetadata* reference = nullptr;
+	for (const auto& member : record.member_metadata) {
+		if (member.referenced_record != referenced_record.name) {
+			continue;
+		}
+		if (reference != nullptr) {
+			throw std::invalid_argument("Record " + record.name + " has several members referring to record " + referenced_record.name);
+		}
+		reference = &member;
+	}
+	if (reference == nullptr) {
+		throw std::invalid_argument("Record " + record.name + " has no member referring to record " + referenced_record.name);
+	}
+	return *reference;
+}
+
+std::string FullTextSearchTableName(const Reflection& record) {
+	return record.name + "_fts";
+}
+
+uint64_t SchemaHash(const Reflection& record) {
+	std::string schema(record.name);
+	for (const auto& member : record.member_metadata) {
+		// the storage class is hashed as well, since several encodings share the same column type, such as BLOB
+		schema += ";" + member.name + " " + member.sqlite_column_name + " " + std::to_string((int)member.storage_class)
+			+ (member.full_text_search ? " FTS" : "");
+		if (!member.referenced_record.empty()) {
+			schema += " REFERENCES " + member.referenced_record;
+		}
+	}
+
+	uint64_t hash = 14695981039346656037ULL;
+	for (const auto c : schema) {
+		hash ^= (unsigned char)c;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
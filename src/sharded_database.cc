@@ -0,0 +1,89 @@
+// MIT License
+//
+// Copyright (c) 2023 Ioannis Kaliakatsos
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "sharded_database.h"
+
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+using namespace sqlite_reflection;
+
+ShardedDatabase::ShardedDatabase(const std::vector<std::string>& paths, const TableCreation table_creation) {
+	if (paths.empty()) {
+		throw std::invalid_argument("A sharded database needs at least one shard");
+	}
+	shards_.reserve(paths.size());
+	for (const auto& path : paths) {
+		shards_.emplace_back(path, table_creation);
+	}
+}
+
+size_t ShardedDatabase::ShardCount() const {
+	return shards_.size();
+}
+
+const Database& ShardedDatabase::Shard(const size_t index) const {
+	return shards_.at(index);
+}
+
+size_t ShardedDatabase::ShardIndex(const int64_t id) const {
+	// the finalizer of splitmix64, so that ids which share a pattern, such as a common stride, are still spread evenly
+	auto hash = (uint64_t)id;
+	hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBULL;
+	hash ^= hash >> 31;
+	return (size_t)(hash % shards_.size());
+}
+
+const Database& ShardedDatabase::ShardOf(const int64_t id) const {
+	return shards_[ShardIndex(id)];
+}
+
+void ShardedDatabase::ForEachShard(const std::function<void(size_t)>& fn) const {
+	if (shards_.size() == 1) {
+		fn(0);
+		return;
+	}
+
+	std::vector<std::exception_ptr> exceptions(shards_.size());
+	std::vector<std::thread> threads;
+	threads.reserve(shards_.size());
+	for (size_t index = 0; index < shards_.size(); ++index) {
+		threads.emplace_back([&fn, &exceptions, index]() {
+			try {
+				fn(index);
+			}
+			catch (...) {
+				exceptions[index] = std::current_exception();
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	for (const auto& exception : exceptions) {
+		if (exception) {
+			std::rethrow_exception(exception);
+		}
+	}
+}
@@ -23,7 +23,6 @@
 #include "internal/string_utilities.h"
 
 #include <codecvt>
-#include <numeric>
 #include <sstream>
 #ifndef _WIN32
 #include <locale>
@@ -85,13 +84,19 @@ std::string StringUtilities::Join(const std::vector<std::string>& list, const st
 		return list[0];
 	}
 
-	return std::accumulate(
-		list.begin() + 1,
-		list.end(),
-		list[0],
-		[&](const std::string& a, const std::string& b){
-			return a + separator + b;
-		});
+	auto length = separator.length() * (size - 1);
+	for (const auto& item : list) {
+		length += item.length();
+	}
+
+	std::string joined;
+	joined.reserve(length);
+	joined += list[0];
+	for (auto i = 1; i < size; ++i) {
+		joined += separator;
+		joined += list[i];
+	}
+	return joined;
 }
 
 std::string StringUtilities::Join(const std::vector<std::string>& list, char c) {
@@ -0,0 +1,134 @@
+// MIT License
+//
+// Copyright (c) 2023 Ioannis Kaliakatsos
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "internal/text_compression.h"
+
+#include <stdexcept>
+
+#ifdef SQLITE_REFLECTION_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace sqlite_reflection;
+
+const size_t TextCompression::kThreshold;
+const size_t TextCompression::kMaxHeaderSize;
+
+/// The maximum ratio between the sizes of decompressed and compressed data, which deflate cannot exceed
+static const uint64_t max_expansion_ratio = 1032;
+
+static void AppendSize(std::string& blob, uint64_t size) {
+	for (auto i = 0; i < 8; ++i) {
+		blob.push_back((char)(size & 0xFF));
+		size >>= 8;
+	}
+}
+
+static uint64_t ReadSize(const uint8_t* bytes) {
+	uint64_t size = 0;
+	for (auto i = 7; i >= 0; --i) {
+		size = (size << 8) | bytes[i];
+	}
+	return size;
+}
+
+bool TextCompression::IsAvailable() {
+#ifdef SQLITE_REFLECTION_ZLIB
+	return true;
+#else
+	return false;
+#endif
+}
+
+std::string TextCompression::Compress(const std::string& utf8_text) {
+#ifdef SQLITE_REFLECTION_ZLIB
+	if (utf8_text.size() >= kThreshold) {
+		auto compressed_size = compressBound((uLong)utf8_text.size());
+		std::string blob(kMaxHeaderSize + compressed_size, '\0');
+		const auto result = compress2(reinterpret_cast<Bytef*>(&blob[kMaxHeaderSize]), &compressed_size,
+		                              reinterpret_cast<const Bytef*>(utf8_text.data()), (uLong)utf8_text.size(), Z_DEFAULT_COMPRESSION);
+		if (result == Z_OK && kMaxHeaderSize + compressed_size < utf8_text.size() + 1) {
+			blob.resize(kMaxHeaderSize + compressed_size);
+			std::string header(1, (char)kZlib);
+			AppendSize(header, utf8_text.size());
+			blob.replace(0, kMaxHeaderSize, header);
+			return blob;
+		}
+	}
+#endif
+
+	std::string blob;
+	blob.reserve(utf8_text.size() + 1);
+	blob.push_back((char)kStored);
+	blob += utf8_text;
+	return blob;
+}
+
+std::string TextCompression::Decompress(const void* data, const size_t size) {
+	const auto bytes = static_cast<const uint8_t*>(data);
+	if (size == 0) {
+		return std::string();
+	}
+
+	switch (bytes[0]) {
+	case kStored:
+		return std::string(reinterpret_cast<const char*>(bytes + 1), size - 1);
+
+	case kZlib:
+		{
+			if (size < kMaxHeaderSize) {
+				throw std::runtime_error("Compressed text is truncated");
+			}
+#ifdef SQLITE_REFLECTION_ZLIB
+			// the size in the header is checked before allocating, so that corrupt values cannot request huge allocations
+			const auto stored_text_size = ReadSize(bytes + 1);
+			if (stored_text_size > (size - kMaxHeaderSize) * max_expansion_ratio || stored_text_size != (uLongf)stored_text_size) {
+				throw std::runtime_error("Compressed text is corrupt");
+			}
+			uLongf text_size = (uLongf)stored_text_size;
+			std::string utf8_text(text_size, '\0');
+			const auto result = uncompress(reinterpret_cast<Bytef*>(&utf8_text[0]), &text_size,
+			                               bytes + kMaxHeaderSize, (uLong)(size - kMaxHeaderSize));
+			if (result != Z_OK || text_size != utf8_text.size()) {
+				throw std::runtime_error("Compressed text is corrupt");
+			}
+			return utf8_text;
+#else
+			throw std::runtime_error("Compressed text cannot be read, since the library was built without zlib");
+#endif
+		}
+
+	default:
+		throw std::runtime_error("Compressed text has an unknown codec");
+	}
+}
+
+uint64_t TextCompression::UncompressedSize(const void* header, const size_t header_size, const size_t blob_size) {
+	const auto bytes = static_cast<const uint8_t*>(header);
+	if (header_size == 0 || blob_size == 0) {
+		return 0;
+	}
+	if (bytes[0] == kZlib && header_size >= kMaxHeaderSize) {
+		return ReadSize(bytes + 1);
+	}
+	return blob_size - 1;
+}
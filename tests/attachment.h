@@ -21,14 +21,12 @@
 // SOFTWARE.
 
 #pragma once
+
 #include <string>
 #include <vector>
 
-namespace sqlite_reflection {
-	/// A wrapper of the results of an SQLite SELECT query
-	struct FetchQueryResults
-	{
-		std::vector<std::string> column_names;
-		std::vector<std::vector<std::wstring>> row_values;
-	};
-}
+#define REFLECTABLE Attachment
+#define FIELDS \
+MEMBER_TEXT(file_name) \
+MEMBER_BLOB(content)
+#include "reflection.h"
@@ -21,11 +21,23 @@
 // SOFTWARE.
 
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <type_traits>
 #include "database.h"
+#include "sharded_database.h"
+#include "query_expressions.h"
 
 #include "person.h"
 #include "pet.h"
 #include "company.h"
+#include "device.h"
+#include "attachment.h"
+#include "sensor.h"
+#include "audit_entry.h"
+#include "dog.h"
+#include "article.h"
 
 using namespace sqlite_reflection;
 
@@ -38,6 +50,20 @@ class DatabaseTest : public ::testing::Test
 	void TearDown() override {
 		Database::Finalize();
 	}
+
+protected:
+	/// Saves the five companies shared by the ordering, limit, aggregate and grouping tests
+	static void SaveCompanies() {
+		std::vector<Company> company;
+
+		company.push_back({L"Paul", 32, L"California", 20000.0, 1});
+		company.push_back({L"Allen", 25, L"Texas", 15000.0, 2});
+		company.push_back({L"Teddy", 23, L"Norway", 20000.0, 3});
+		company.push_back({L"Mark", 25, L"Rich-Mond", 65000.0, 4});
+		company.push_back({L"David", 27, L"Texas", 85000.0, 5});
+
+		Database::Instance().Save(company);
+	}
 };
 
 TEST_F(DatabaseTest, Initialization) {
@@ -80,6 +106,35 @@ TEST_F(DatabaseTest, SingleInsertionWithAutoIdIncrement) {
     EXPECT_EQ(1, all_persons[0].id);
 }
 
+TEST_F(DatabaseTest, MultipleInsertionsWithAutoIdIncrementWriteBackIds) {
+	const auto& db = Database::Instance();
+
+	db.Save(Person{L"john", L"appleseed", 28, false, 7});
+	db.EnableInstrumentation(0.0);
+
+	std::vector<Person> persons;
+	persons.push_back({L"παναγιώτης", L"ανδριανόπουλος", 28, false});
+	persons.push_back({L"peter", L"meier", 32, true});
+
+	const auto ids = db.SaveAutoIncrement(persons);
+	EXPECT_EQ(std::vector<int64_t>({8, 9}), ids);
+	EXPECT_EQ(8, persons[0].id);
+	EXPECT_EQ(9, persons[1].id);
+
+	Person mary{L"mary", L"poppins", 20, true};
+	EXPECT_EQ(10, db.SaveAutoIncrement(mary));
+	EXPECT_EQ(10, mary.id);
+	EXPECT_EQ(mary.first_name, db.Fetch<Person>(10).first_name);
+
+	// the ids are assigned by SQLite, without reading the current max id first
+	const auto statistics = db.Stats();
+	for (const auto& query : statistics.slow_queries) {
+		EXPECT_EQ(std::string::npos, query.sql.find("MAX(id)"));
+	}
+	EXPECT_EQ(3, statistics.operations.at(std::make_pair(std::string("Person"), std::string("SaveAutoIncrement"))).latency.Count());
+	db.DisableInstrumentation();
+}
+
 TEST_F(DatabaseTest, MultipleInsertions) {
 	const auto& db = Database::Instance();
 
@@ -245,6 +300,36 @@ TEST_F(DatabaseTest, DeleteWithPredicate) {
     EXPECT_EQ(false, fetched_persons[0].is_vaccinated);
 }
 
+TEST_F(DatabaseTest, DeleteWithEmptyPredicate) {
+	const auto& db = Database::Instance();
+
+	std::vector<Person> persons;
+	persons.push_back({L"john", L"appleseed", 28, false, 3});
+	persons.push_back({L"mary", L"poppins", 20, true, 5});
+	db.Save(persons);
+
+	const EmptyPredicate all_persons;
+	db.Delete<Person>(&all_persons);
+	EXPECT_EQ(0, db.Count<Person>());
+}
+
+TEST_F(DatabaseTest, DeleteWithBoundPredicate) {
+	const auto& db = Database::Instance();
+
+	std::vector<Person> persons;
+	persons.push_back({L"o'neil", L"meier", 28, true, 3});
+	persons.push_back({L"peter", L"o'neil", 32, false, 5});
+	db.Save(persons);
+
+	const auto quoted_name_predicate = Equal(&Person::first_name, L"o'neil");
+	db.Delete<Person>(&quoted_name_predicate);
+	db.Delete<Person>(&quoted_name_predicate);
+
+	const auto fetched_persons = db.FetchAll<Person>();
+	ASSERT_EQ(1, fetched_persons.size());
+	EXPECT_EQ(5, fetched_persons[0].id);
+}
+
 TEST_F(DatabaseTest, SingleFetch) {
 	const auto& db = Database::Instance();
 
@@ -413,6 +498,471 @@ TEST_F(DatabaseTest, FetchWithPredicateChaining) {
 	EXPECT_EQ(37, fetched_persons[1].age);
 }
 
+TEST_F(DatabaseTest, FetchKeepsIntegersBeyond32Bits) {
+	const auto& db = Database::Instance();
+
+	db.Save(Person{L"john", L"appleseed", 5000000000, false, 1});
+
+	EXPECT_EQ(5000000000, db.Fetch<Person>(1).age);
+	EXPECT_EQ(5000000000, db.FetchAll<Person>()[0].age);
+}
+
+TEST_F(DatabaseTest, Utf8TextMembers) {
+	const auto& db = Database::Instance();
+
+	db.Save(Device{"SN-001", L"θερμόμετρο", 1});
+	db.Save(Device{"SN-002", L"barometer", 2});
+	db.Save(Device{"XN-003", L"hygrometer", 3});
+
+	const auto device = db.Fetch<Device>(1);
+	EXPECT_EQ("SN-001", device.serial_number);
+	EXPECT_EQ(L"θερμόμετρο", device.description);
+
+	const auto serial_number = Equal(&Device::serial_number, "SN-002");
+	const auto fetched_devices = db.Fetch<Device>(&serial_number);
+	ASSERT_EQ(1, fetched_devices.size());
+	EXPECT_EQ(2, fetched_devices[0].id);
+
+	const StartsWith prefix(&Device::serial_number, "SN");
+	EXPECT_EQ(2, db.Count<Device>(&prefix));
+
+	db.Save(Device{std::string("SN\xFF\x01", 4), L"raw", 4});
+	const StartsWith raw_prefix(&Device::serial_number, std::string("SN\xFF", 3));
+	EXPECT_EQ(1, db.Count<Device>(&raw_prefix));
+	db.Delete<Device>(4);
+
+	const auto in = In(&Device::serial_number, std::vector<std::string>{"SN-001", "XN-003"});
+	EXPECT_EQ(2, db.Count<Device>(&in));
+
+	EXPECT_EQ("XN-003", db.Max(&Device::serial_number));
+
+	auto fetch = db.PrepareFetch<Device>(&serial_number);
+	EXPECT_EQ(3, fetch.Bind(0, "XN-003").Execute()[0].id);
+}
+
+TEST_F(DatabaseTest, BlobMembers) {
+	const auto& db = Database::Instance();
+
+	const std::vector<uint8_t> content{0x00, 0x7F, 0x80, 0xFF, 0x00};
+	db.Save(Attachment{L"data.bin", content, 1});
+	db.Save(Attachment{L"empty.bin", std::vector<uint8_t>(), 2});
+
+	auto attachment = db.Fetch<Attachment>(1);
+	EXPECT_EQ(content, attachment.content);
+	EXPECT_TRUE(db.Fetch<Attachment>(2).content.empty());
+
+	attachment.content.assign(100000, 0xAB);
+	db.Update(attachment);
+	EXPECT_EQ(attachment.content, db.Fetch<Attachment>(1).content);
+
+	const auto equal_content = Equal(&Attachment::content, attachment.content);
+	const auto fetched_attachments = db.Fetch<Attachment>(&equal_content);
+	ASSERT_EQ(1, fetched_attachments.size());
+	EXPECT_EQ(L"data.bin", fetched_attachments[0].file_name);
+}
+
+TEST_F(DatabaseTest, PackedArrayMembers) {
+	const auto& db = Database::Instance();
+
+	const std::vector<double> samples{0.1234567890123, -1e300, 0, 42.5};
+	const std::vector<int64_t> counts{0, -1, INT64_MIN, INT64_MAX, 7};
+	const std::vector<int64_t> timestamps{1700000000000, 1700000000250, 1700000000500, 1699999999000, INT64_MIN, INT64_MAX};
+	db.Save(Sensor{L"thermometer", samples, counts, timestamps, 1});
+	db.Save(Sensor{L"idle", std::vector<double>(), std::vector<int64_t>(), std::vector<int64_t>(), 2});
+
+	const auto sensor = db.Fetch<Sensor>(1);
+	EXPECT_EQ(samples, sensor.samples);
+	EXPECT_EQ(counts, sensor.counts);
+	EXPECT_EQ(timestamps, sensor.timestamps);
+
+	const auto idle = db.Fetch<Sensor>(2);
+	EXPECT_TRUE(idle.samples.empty());
+	EXPECT_TRUE(idle.counts.empty());
+	EXPECT_TRUE(idle.timestamps.empty());
+
+	const auto equal_counts = Equal(&Sensor::counts, counts);
+	const auto equal_timestamps = Equal(&Sensor::timestamps, timestamps);
+	const auto equal = equal_counts.And(equal_timestamps);
+	const auto fetched_sensors = db.Fetch<Sensor>(&equal);
+	ASSERT_EQ(1, fetched_sensors.size());
+	EXPECT_EQ(L"thermometer", fetched_sensors[0].name);
+}
+
+TEST_F(DatabaseTest, CompressedTextMembers) {
+	const auto& db = Database::Instance();
+
+	std::wstring payload(L"{\"entries\": [");
+	for (auto i = 0; i < 200; ++i) {
+		payload += L"{\"user\": \"müller\", \"event\": \"login\"},";
+	}
+	payload += L"]}";
+	db.Save(AuditEntry{L"login", payload, 1});
+	db.Save(AuditEntry{L"logout", L"{}", 2});
+	db.Save(AuditEntry{L"noop", L"", 3});
+
+	EXPECT_EQ(payload, db.Fetch<AuditEntry>(1).payload);
+	EXPECT_EQ(L"{}", db.Fetch<AuditEntry>(2).payload);
+	EXPECT_EQ(L"", db.Fetch<AuditEntry>(3).payload);
+
+	const auto equal_payload = Equal(&AuditEntry::payload, payload);
+	const auto fetched_entries = db.Fetch<AuditEntry>(&equal_payload);
+	ASSERT_EQ(1, fetched_entries.size());
+	EXPECT_EQ(L"login", fetched_entries[0].action);
+
+	// every character of the payload is encoded in a single UTF-8 byte, except for ü which takes two
+	const auto payload_bytes = payload.size() + 200;
+	const auto statistics = db.CompressionStats();
+	EXPECT_EQ(3, statistics.values);
+	EXPECT_EQ(payload_bytes + 2, statistics.uncompressed_bytes);
+	if (Database::IsCompressionAvailable()) {
+		EXPECT_EQ(1, statistics.compressed_values);
+		EXPECT_GT(statistics.BytesSaved(), (int64_t)payload_bytes / 2);
+	} else {
+		EXPECT_EQ(0, statistics.compressed_values);
+		EXPECT_EQ(-3, statistics.BytesSaved());
+	}
+
+	// a corrupt header claiming about a terabyte of text is rejected, instead of being allocated
+	db.Sql("UPDATE AuditEntry SET payload = X'01FFFFFFFFFF000000789C030000000001' WHERE id = 2");
+	EXPECT_THROW(db.Fetch<AuditEntry>(2), std::runtime_error);
+}
+
+TEST_F(DatabaseTest, FetchWithRelatedRecords) {
+	const auto& db = Database::Instance();
+
+	std::vector<Person> persons;
+	persons.push_back({L"john", L"appleseed", 28, false, 1});
+	persons.push_back({L"mary", L"poppins", 20, false, 2});
+	persons.push_back({L"jane", L"doe", 40, true, 3});
+	db.Save(persons);
+
+	std::vector<Dog> dogs;
+	dogs.push_back({L"rex", 1, 1});
+	dogs.push_back({L"fido", 3, 2});
+	dogs.push_back({L"lassie", 1, 3});
+	dogs.push_back({L"stray", 42, 4});
+	db.Save(dogs);
+
+	const auto persons_with_dogs = db.FetchWith<Person, Dog>();
+	ASSERT_EQ(3, persons_with_dogs.size());
+	EXPECT_EQ(L"john", persons_with_dogs[0].first.first_name);
+	ASSERT_EQ(2, persons_with_dogs[0].second.size());
+	EXPECT_EQ(L"rex", persons_with_dogs[0].second[0].name);
+	EXPECT_EQ(L"lassie", persons_with_dogs[0].second[1].name);
+	EXPECT_TRUE(persons_with_dogs[1].second.empty());
+	ASSERT_EQ(1, persons_with_dogs[2].second.size());
+	EXPECT_EQ(L"fido", persons_with_dogs[2].second[0].name);
+
+	const auto older = GreaterThan(&Person::age, 30);
+	const auto older_with_dogs = db.FetchWith<Person, Dog>(&Dog::owner_id, &older);
+	ASSERT_EQ(1, older_with_dogs.size());
+	EXPECT_EQ(3, older_with_dogs[0].first.id);
+	ASSERT_EQ(1, older_with_dogs[0].second.size());
+	EXPECT_EQ(2, older_with_dogs[0].second[0].id);
+
+	const auto nobody = Equal(&Person::first_name, L"nobody");
+	EXPECT_TRUE((db.FetchWith<Person, Dog>(&nobody).empty()));
+
+	EXPECT_THROW((db.FetchWith<Person, Pet>()), std::invalid_argument);
+}
+
+TEST_F(DatabaseTest, JoinRecords) {
+	const auto& db = Database::Instance();
+
+	std::vector<Person> persons;
+	persons.push_back({L"john", L"appleseed", 28, false, 1});
+	persons.push_back({L"mary", L"poppins", 20, false, 2});
+	persons.push_back({L"jane", L"doe", 40, true, 3});
+	db.Save(persons);
+
+	std::vector<Dog> dogs;
+	dogs.push_back({L"rex", 1, 1});
+	dogs.push_back({L"fido", 3, 2});
+	dogs.push_back({L"lassie", 1, 3});
+	dogs.push_back({L"stray", 42, 4});
+	db.Save(dogs);
+
+	auto persons_and_dogs = db.Join(&Person::id, &Dog::owner_id);
+	ASSERT_EQ(3, persons_and_dogs.size());
+	std::sort(persons_and_dogs.begin(), persons_and_dogs.end(), [](const std::pair<Person, Dog>& lhs, const std::pair<Person, Dog>& rhs) {
+		return lhs.second.id < rhs.second.id;
+	});
+	EXPECT_EQ(L"john", persons_and_dogs[0].first.first_name);
+	EXPECT_EQ(L"rex", persons_and_dogs[0].second.name);
+	EXPECT_EQ(L"jane", persons_and_dogs[1].first.first_name);
+	EXPECT_EQ(40, persons_and_dogs[1].first.age);
+	EXPECT_EQ(L"fido", persons_and_dogs[1].second.name);
+	EXPECT_EQ(1, persons_and_dogs[2].first.id);
+	EXPECT_EQ(3, persons_and_dogs[2].second.id);
+
+	// both records have members named id, which are not ambiguous in their predicates
+	const auto john = Equal(&Person::id, 1);
+	const auto lassie = Equal(&Dog::id, 3);
+	const auto john_and_lassie = db.Join(&Person::id, &Dog::owner_id, &john, &lassie);
+	ASSERT_EQ(1, john_and_lassie.size());
+	EXPECT_EQ(L"appleseed", john_and_lassie[0].first.last_name);
+	EXPECT_EQ(L"lassie", john_and_lassie[0].second.name);
+
+	const auto nobody = Equal(&Person::first_name, L"nobody");
+	EXPECT_TRUE(db.Join(&Person::id, &Dog::owner_id, &nobody).empty());
+}
+
+TEST_F(DatabaseTest, RawQueryCursor) {
+	const auto& db = Database::Instance();
+
+	std::vector<Person> persons;
+	persons.push_back({L"john", L"appleseed", 28, false, 1});
+	persons.push_back({L"mary", L"poppins", 20, false, 2});
+	persons.push_back({L"jane", L"appleseed", 40, true, 3});
+	persons.push_back({L"o'neil", L"müller", 33, false, 4});
+	db.Save(persons);
+
+	auto cursor = db.Query("SELECT last_name, COUNT(*), AVG(age) FROM Person WHERE age >= ? GROUP BY last_name ORDER BY last_name", 25);
+	ASSERT_EQ(3, cursor.ColumnCount());
+	EXPECT_EQ("last_name", cursor.ColumnName(0));
+	ASSERT_TRUE(cursor.Next());
+	EXPECT_EQ(L"appleseed", cursor.GetWideText(0));
+	EXPECT_EQ(2, cursor.GetInt64(1));
+	EXPECT_EQ(34.0, cursor.GetDouble(2));
+	ASSERT_TRUE(cursor.Next());
+	EXPECT_EQ("müller", cursor.GetText(0));
+	EXPECT_FALSE(cursor.Next());
+
+	auto max_cursor = db.Query("SELECT MAX(age) FROM Person WHERE first_name = ?", L"o'neil");
+	ASSERT_TRUE(max_cursor.Next());
+	EXPECT_FALSE(max_cursor.IsNull(0));
+	EXPECT_EQ(33, max_cursor.GetInt64(0));
+
+	auto null_cursor = db.Query("SELECT MAX(age) FROM Person WHERE first_name = ?", "nobody");
+	ASSERT_TRUE(null_cursor.Next());
+	EXPECT_TRUE(null_cursor.IsNull(0));
+
+	static_assert(std::is_nothrow_move_constructible<Cursor>::value, "Cursor must be nothrow move constructible");
+	static_assert(std::is_nothrow_move_assignable<Cursor>::value, "Cursor must be nothrow move assignable");
+	null_cursor = std::move(max_cursor);
+	ASSERT_FALSE(null_cursor.Next());
+	null_cursor = db.Query("SELECT COUNT(*) FROM Person");
+	ASSERT_TRUE(null_cursor.Next());
+	EXPECT_EQ(4, null_cursor.GetInt64(0));
+
+	const auto older = db.Query<Person>("SELECT * FROM Person WHERE age > ? AND is_vaccinated = ? ORDER BY age", 30, false);
+	ASSERT_EQ(1, older.size());
+	EXPECT_EQ(L"o'neil", older[0].first_name);
+	EXPECT_EQ(L"müller", older[0].last_name);
+	EXPECT_EQ(4, older[0].id);
+
+	// columns are matched by name, so partial and reordered results can be read as well
+	const auto partial = db.Query<Person>("SELECT id, first_name FROM Person WHERE last_name = ? ORDER BY id DESC", std::string("appleseed"));
+	ASSERT_EQ(2, partial.size());
+	EXPECT_EQ(3, partial[0].id);
+	EXPECT_EQ(L"jane", partial[0].first_name);
+	EXPECT_EQ(L"", partial[0].last_name);
+	EXPECT_EQ(0, partial[0].age);
+
+	EXPECT_THROW(db.Query("SELECT * FROM Person WHERE age > ?"), std::invalid_argument);
+	EXPECT_THROW(db.Query("SELECT * FROM Nothing"), std::runtime_error);
+
+	// the table of the hydrated record is created on demand, and the query is instrumented like any other fetch
+	Database lazy("", TableCreation::kLazy);
+	lazy.EnableInstrumentation(1000.0);
+	EXPECT_TRUE(lazy.Query<Person>("SELECT * FROM Person").empty());
+	lazy.Save(Person{L"john", L"appleseed", 28, false, 1});
+	EXPECT_EQ(1, lazy.Query<Person>("SELECT * FROM Person").size());
+	const auto query_statistics = lazy.Stats().operations.at(std::make_pair(std::string("Person"), std::string("Query")));
+	EXPECT_EQ(2, query_statistics.latency.Count());
+	EXPECT_EQ(1, query_statistics.rows);
+}
+
+TEST_F(DatabaseTest, IndependentInstances) {
+	const auto& singleton = Database::Instance();
+	singleton.Save(Person{L"john", L"appleseed", 28, false, 1});
+
+	Database other("");
+	EXPECT_EQ(0, other.Count<Person>());
+	other.Save(Person{L"mary", L"poppins", 20, false, 1});
+	EXPECT_EQ(L"john", singleton.Fetch<Person>(1).first_name);
+	EXPECT_EQ(L"mary", other.Fetch<Person>(1).first_name);
+
+	const Equal mary_id(&Person::id, 1);
+	auto prepared_fetch = other.PrepareFetch<Person>(&mary_id);
+
+	static_assert(std::is_nothrow_move_constructible<Database>::value, "Databases need to be moved without throwing");
+	Database moved(std::move(other));
+	EXPECT_EQ(L"mary", moved.Fetch<Person>(1).first_name);
+	ASSERT_EQ(1, prepared_fetch.Execute().size());
+
+	Database lazy("", TableCreation::kLazy);
+	lazy = std::move(moved);
+	EXPECT_EQ(L"poppins", lazy.Fetch<Person>(1).last_name);
+}
+
+TEST_F(DatabaseTest, ShardedDatabase) {
+	ShardedDatabase db(std::vector<std::string>{"", "", ""});
+	ASSERT_EQ(3, db.ShardCount());
+
+	std::vector<Person> persons;
+	for (auto i = 1; i <= 90; ++i) {
+		persons.push_back({L"name" + std::to_wstring(i), L"surname", i, i % 2 == 0, i});
+	}
+	db.Save(persons);
+
+	// every record is stored exactly once, in the shard of its id
+	int64_t total = 0;
+	for (size_t index = 0; index < db.ShardCount(); ++index) {
+		const auto shard_persons = db.Shard(index).FetchAll<Person>();
+		EXPECT_GT(shard_persons.size(), 10);
+		for (const auto& person : shard_persons) {
+			EXPECT_EQ(index, db.ShardIndex(person.id));
+		}
+		total += shard_persons.size();
+	}
+	EXPECT_EQ(90, total);
+	EXPECT_EQ(90, db.FetchAll<Person>().size());
+	EXPECT_EQ(90, db.Count<Person>());
+
+	EXPECT_EQ(L"name42", db.Fetch<Person>(42).first_name);
+	const auto vaccinated = Equal(&Person::is_vaccinated, true);
+	EXPECT_EQ(45, db.Fetch<Person>(&vaccinated).size());
+
+	auto person = db.Fetch<Person>(7);
+	person.age = 70;
+	db.Update(person);
+	EXPECT_EQ(70, db.Fetch<Person>(7).age);
+
+	db.Delete<Person>(7);
+	EXPECT_EQ(89, db.Count<Person>());
+	EXPECT_THROW(db.Fetch<Person>(7), std::runtime_error);
+
+	EXPECT_THROW(ShardedDatabase(std::vector<std::string>()), std::invalid_argument);
+}
+
+TEST_F(DatabaseTest, BackupAndLoadFromFile) {
+	const auto& db = Database::Instance();
+	const auto path = ::testing::TempDir() + "sqlite_reflection_backup.db";
+	std::remove(path.data());
+
+	std::vector<Person> persons;
+	for (auto i = 1; i <= 500; ++i) {
+		persons.push_back({L"name" + std::to_wstring(i), std::wstring(200, L'x'), i, false, i});
+	}
+	db.Save(persons);
+
+	std::vector<int> remaining_pages;
+	auto backup = db.BackupTo(path, 4, [&remaining_pages](int remaining, int total) {
+		EXPECT_LE(remaining, total);
+		remaining_pages.push_back(remaining);
+	});
+	backup.get();
+	ASSERT_GT(remaining_pages.size(), 1);
+	EXPECT_EQ(0, remaining_pages.back());
+
+	{
+		Database backup_file(path);
+		EXPECT_EQ(500, backup_file.Count<Person>());
+	}
+
+	auto replica = Database::LoadFromFile(path);
+	EXPECT_EQ(500, replica.Count<Person>());
+	EXPECT_EQ(L"name250", replica.Fetch<Person>(250).first_name);
+
+	// the replica is in memory, so its changes do not affect the file
+	replica.Delete<Person>(250);
+	EXPECT_EQ(499, replica.Count<Person>());
+	EXPECT_EQ(500, Database(path).Count<Person>());
+
+	// databases in files are read through their own connection, while the original one keeps being written to
+	const auto copy_path = ::testing::TempDir() + "sqlite_reflection_backup_copy.db";
+	std::remove(copy_path.data());
+	{
+		Database file(path);
+		auto file_backup = file.BackupTo(copy_path, 4);
+		file.Save(Person{L"late", L"writer", 20, false, 501});
+		file_backup.get();
+	}
+	const auto copied_persons = Database(copy_path).Count<Person>();
+	EXPECT_TRUE(copied_persons == 500 || copied_persons == 501);
+
+	EXPECT_THROW(Database::LoadFromFile(::testing::TempDir() + "missing/sqlite_reflection.db"), std::invalid_argument);
+	std::remove(copy_path.data());
+	std::remove(path.data());
+}
+
+TEST_F(DatabaseTest, IncrementalBlobIO) {
+	const auto& db = Database::Instance();
+
+	db.Save(Attachment{L"data.bin", std::vector<uint8_t>(), 1});
+	db.ReserveBlob(&Attachment::content, 1, 10);
+
+	{
+		auto blob = db.OpenBlob(&Attachment::content, 1, true);
+		EXPECT_EQ(10, blob.Size());
+		const uint8_t chunk[] = {1, 2, 3};
+		blob.Write(chunk, 3, 0);
+		blob.Write(chunk, 3, 7);
+		EXPECT_THROW(blob.Write(chunk, 3, 8), std::out_of_range);
+
+		uint8_t read[4] = {};
+		EXPECT_EQ(3, blob.Read(read, 4, 7));
+		EXPECT_EQ(3, read[2]);
+	}
+	EXPECT_EQ(std::vector<uint8_t>({1, 2, 3, 0, 0, 0, 0, 1, 2, 3}), db.Fetch<Attachment>(1).content);
+
+	auto read_only_blob = db.OpenBlob(&Attachment::content, 1);
+	EXPECT_THROW(read_only_blob.Write("", 0, 0), std::runtime_error);
+	EXPECT_THROW(db.OpenBlob(&Attachment::content, 2), std::runtime_error);
+}
+
+TEST_F(DatabaseTest, BlobStream) {
+	const auto& db = Database::Instance();
+
+	std::string payload;
+	for (auto i = 0; i < 1000; ++i) {
+		payload += std::to_string(i) + ",";
+	}
+	db.Save(Attachment{L"data.csv", std::vector<uint8_t>(), 1});
+	db.ReserveBlob(&Attachment::content, 1, payload.size());
+
+	{
+		auto blob = db.OpenBlob(&Attachment::content, 1, true);
+		BlobStream stream(blob, 64);
+		stream << payload;
+		stream.flush();
+		EXPECT_TRUE(stream.good());
+
+		// writing past the reserved size fails
+		stream << "x";
+		stream.flush();
+		EXPECT_TRUE(stream.bad());
+	}
+
+	auto blob = db.OpenBlob(&Attachment::content, 1);
+	BlobStream stream(blob, 64);
+	std::stringstream copy;
+	copy << stream.rdbuf();
+	EXPECT_EQ(payload, copy.str());
+
+	stream.clear();
+	stream.seekg(-4, std::ios_base::end);
+	std::string last;
+	stream >> last;
+	EXPECT_EQ("999,", last);
+}
+
+TEST_F(DatabaseTest, SavedValuesAreBoundVerbatim) {
+	const auto& db = Database::Instance();
+
+	Person p{L"o'neil", L"d'arcy", 5000000000, true, 1};
+	db.Save(p);
+	EXPECT_EQ(L"o'neil", db.Fetch<Person>(1).first_name);
+
+	p.last_name = L"'; DROP TABLE Person; --";
+	db.Update(p);
+	EXPECT_EQ(p.last_name, db.Fetch<Person>(1).last_name);
+
+	db.Save(Pet{L"garfield", 0.1234567890123, 1});
+	EXPECT_EQ(0.1234567890123, db.Fetch<Pet>(1).weight);
+}
+
 TEST_F(DatabaseTest, ReadMaxId) {
 	const auto& db = Database::Instance();
 
@@ -446,3 +996,471 @@ TEST_F(DatabaseTest, RawSqlQueryForPersistedRecord) {
     EXPECT_EQ(52, fetched_persons[0].id);
     EXPECT_EQ(L"johnie", fetched_persons[0].first_name);
 }
+
+TEST_F(DatabaseTest, FetchWithOrdering) {
+	const auto& db = Database::Instance();
+
+	SaveCompanies();
+
+	const auto ordering = OrderBy(&Company::salary, Direction::kDescending)
+	                      .ThenBy(&Company::name);
+
+	const auto fetched_companies = db.FetchAll<Company>(ordering);
+	EXPECT_EQ(5, fetched_companies.size());
+
+	EXPECT_EQ(5, fetched_companies[0].id);
+	EXPECT_EQ(4, fetched_companies[1].id);
+	EXPECT_EQ(1, fetched_companies[2].id);
+	EXPECT_EQ(3, fetched_companies[3].id);
+	EXPECT_EQ(2, fetched_companies[4].id);
+}
+
+TEST_F(DatabaseTest, FetchWithPredicateOrderingAndLimit) {
+	const auto& db = Database::Instance();
+
+	SaveCompanies();
+
+	const auto fetch_condition = GreaterThan(&Company::age, 23);
+	const auto fetched_companies = db.Fetch<Company>(&fetch_condition, OrderBy(&Company::age), 2);
+	EXPECT_EQ(2, fetched_companies.size());
+
+	EXPECT_EQ(25, fetched_companies[0].age);
+	EXPECT_EQ(25, fetched_companies[1].age);
+
+	// the limit is bound to the statement, so that different limits on the same shape of query all apply
+	EXPECT_EQ(0, db.Fetch<Company>(&fetch_condition, OrderBy(&Company::age), 0).size());
+	EXPECT_EQ(1, db.Fetch<Company>(&fetch_condition, OrderBy(&Company::age), 1).size());
+	EXPECT_EQ(4, db.Fetch<Company>(&fetch_condition, OrderBy(&Company::age)).size());
+
+	auto prepared_fetch = db.PrepareFetch<Company>(&fetch_condition, OrderBy(&Company::age, Direction::kDescending), 3);
+	const auto oldest = prepared_fetch.Bind(0, 26).Execute();
+	ASSERT_EQ(2, oldest.size());
+	EXPECT_EQ(32, oldest[0].age);
+}
+
+TEST_F(DatabaseTest, Aggregates) {
+	const auto& db = Database::Instance();
+
+	SaveCompanies();
+
+	EXPECT_EQ(5, db.Count<Company>());
+	EXPECT_EQ(132, db.Sum(&Company::age));
+	EXPECT_EQ(205000.0, db.Sum(&Company::salary));
+	EXPECT_EQ(23, db.Min(&Company::age));
+	EXPECT_EQ(85000.0, db.Max(&Company::salary));
+	EXPECT_EQ(L"Teddy", db.Max(&Company::name));
+	EXPECT_EQ(41000.0, db.Avg(&Company::salary));
+
+	const auto texas = Equal(&Company::address, L"Texas");
+	EXPECT_EQ(2, db.Count<Company>(&texas));
+	EXPECT_EQ(100000.0, db.Sum(&Company::salary, &texas));
+	EXPECT_EQ(26.0, db.Avg(&Company::age, &texas));
+}
+
+TEST_F(DatabaseTest, AggregatesWithoutMatchingRecords) {
+	const auto& db = Database::Instance();
+
+	const auto condition = GreaterThan(&Company::age, 100);
+	EXPECT_EQ(0, db.Count<Company>(&condition));
+	EXPECT_EQ(0.0, db.Sum(&Company::salary, &condition));
+	EXPECT_EQ(0, db.Max(&Company::age, &condition));
+	EXPECT_EQ(0.0, db.Avg(&Company::salary, &condition));
+}
+
+TEST_F(DatabaseTest, GroupByWithAggregates) {
+	const auto& db = Database::Instance();
+
+	SaveCompanies();
+
+	const auto rows = db.GroupBy(&Company::address)
+	                    .Aggregate(Sum(&Company::salary), Count(), Max(&Company::age));
+	EXPECT_EQ(4, rows.size());
+
+	EXPECT_EQ(L"California", std::get<0>(rows[0]));
+	EXPECT_EQ(20000.0, std::get<1>(rows[0]));
+	EXPECT_EQ(1, std::get<2>(rows[0]));
+	EXPECT_EQ(32, std::get<3>(rows[0]));
+
+	EXPECT_EQ(L"Norway", std::get<0>(rows[1]));
+	EXPECT_EQ(20000.0, std::get<1>(rows[1]));
+	EXPECT_EQ(1, std::get<2>(rows[1]));
+	EXPECT_EQ(23, std::get<3>(rows[1]));
+
+	EXPECT_EQ(L"Rich-Mond", std::get<0>(rows[2]));
+	EXPECT_EQ(65000.0, std::get<1>(rows[2]));
+	EXPECT_EQ(1, std::get<2>(rows[2]));
+	EXPECT_EQ(25, std::get<3>(rows[2]));
+
+	EXPECT_EQ(L"Texas", std::get<0>(rows[3]));
+	EXPECT_EQ(100000.0, std::get<1>(rows[3]));
+	EXPECT_EQ(2, std::get<2>(rows[3]));
+	EXPECT_EQ(27, std::get<3>(rows[3]));
+}
+
+TEST_F(DatabaseTest, GroupByWithPredicate) {
+	const auto& db = Database::Instance();
+
+	SaveCompanies();
+
+	const auto condition = GreaterThan(&Company::salary, 18000.0);
+	const auto rows = db.GroupBy(&Company::age, &condition).Aggregate(Avg(&Company::salary));
+	EXPECT_EQ(4, rows.size());
+
+	EXPECT_EQ(23, std::get<0>(rows[0]));
+	EXPECT_EQ(20000.0, std::get<1>(rows[0]));
+	EXPECT_EQ(25, std::get<0>(rows[1]));
+	EXPECT_EQ(65000.0, std::get<1>(rows[1]));
+	EXPECT_EQ(27, std::get<0>(rows[2]));
+	EXPECT_EQ(85000.0, std::get<1>(rows[2]));
+	EXPECT_EQ(32, std::get<0>(rows[3]));
+}
+
+TEST_F(DatabaseTest, Exists) {
+	const auto& db = Database::Instance();
+
+	EXPECT_FALSE(db.Exists<Person>());
+
+	std::vector<Person> persons;
+
+	persons.push_back({L"john", L"appleseed", 28, false, 3});
+	persons.push_back({L"mary", L"poppins", 20, true, 5});
+
+	db.Save(persons);
+
+	EXPECT_TRUE(db.Exists<Person>());
+
+	const auto vaccinated_mary = Equal(&Person::first_name, L"mary").And(Equal(&Person::is_vaccinated, true));
+	EXPECT_TRUE(db.Exists<Person>(&vaccinated_mary));
+
+	const auto vaccinated_john = Equal(&Person::first_name, L"john").And(Equal(&Person::is_vaccinated, true));
+	EXPECT_FALSE(db.Exists<Person>(&vaccinated_john));
+}
+
+TEST_F(DatabaseTest, FetchWithInAndBetweenPredicates) {
+	const auto& db = Database::Instance();
+
+	std::vector<Person> persons;
+	std::vector<int64_t> even_ids;
+	for (auto i = 1; i <= 5000; ++i) {
+		persons.push_back({L"name", L"surname", i % 100, false, i});
+		if (i % 2 == 0) {
+			even_ids.push_back(i);
+		}
+	}
+
+	db.Save(persons);
+
+	const auto even_ids_condition = In(&Person::id, even_ids);
+	EXPECT_EQ(2500, db.Count<Person>(&even_ids_condition));
+
+	std::vector<int> ages;
+	for (auto i = 0; i < 20; ++i) {
+		ages.push_back(i * 5);
+	}
+	const auto ages_condition = In(&Person::age, ages);
+	EXPECT_EQ(1000, db.Count<Person>(&ages_condition));
+
+	const auto fetch_condition = In(&Person::id, even_ids)
+	                             .And(Between(&Person::age, 10, 11));
+	const auto fetched_persons = db.Fetch<Person>(&fetch_condition);
+	EXPECT_EQ(50, fetched_persons.size());
+	for (const auto& person : fetched_persons) {
+		EXPECT_EQ(10, person.age);
+	}
+}
+
+TEST_F(DatabaseTest, PreparedFetchAfterFailedRead) {
+	const auto& db = Database::Instance();
+
+	db.Save(AuditEntry{L"login", L"{}", 1});
+	db.Save(AuditEntry{L"corrupt", L"{}", 2});
+	db.Sql("UPDATE AuditEntry SET payload = X'7F' WHERE id = 2");
+
+	const Equal action(&AuditEntry::action, L"");
+	auto fetch = db.PrepareFetch<AuditEntry>(&action);
+	EXPECT_THROW(fetch.Bind(0, L"corrupt").Execute(), std::runtime_error);
+
+	// the statement is reset after the failed read, so that new values are bound and a new scan is started
+	const auto logins = fetch.Bind(0, L"login").Execute();
+	ASSERT_EQ(1, logins.size());
+	EXPECT_EQ(1, logins[0].id);
+}
+
+TEST_F(DatabaseTest, PreparedFetchWithRebinding) {
+	const auto& db = Database::Instance();
+
+	std::vector<Person> persons;
+
+	persons.push_back({L"john", L"appleseed", 28, false, 3});
+	persons.push_back({L"mary", L"poppins", 20, true, 5});
+	persons.push_back({L"oneil", L"smith", 28, true, 8});
+
+	db.Save(persons);
+
+	const Equal age(&Person::age, 0);
+	auto fetch = db.PrepareFetch<Person>(&age, OrderBy(&Person::id, Direction::kDescending));
+
+	EXPECT_EQ(0, fetch.Execute().size());
+
+	const auto twenty_eight = fetch.Bind(0, 28).Execute();
+	ASSERT_EQ(2, twenty_eight.size());
+	EXPECT_EQ(8, twenty_eight[0].id);
+	EXPECT_EQ(3, twenty_eight[1].id);
+
+	const auto twenty = fetch.Bind(0, 20).Execute();
+	ASSERT_EQ(1, twenty.size());
+	EXPECT_EQ(L"mary", twenty[0].first_name);
+
+	const Equal name(&Person::first_name, L"oneil");
+	auto fetch_by_name = db.PrepareFetch<Person>(&name);
+	ASSERT_EQ(1, fetch_by_name.Execute().size());
+	EXPECT_EQ(3, fetch_by_name.Bind(0, L"john").Execute()[0].id);
+
+	const Equal other_name(&Person::first_name, L"mary");
+	EXPECT_EQ(5, fetch_by_name.Bind(&other_name).Execute()[0].id);
+
+	const Equal other_shape(&Person::last_name, L"poppins");
+	EXPECT_THROW(fetch_by_name.Bind(&other_shape), std::invalid_argument);
+	EXPECT_THROW(fetch_by_name.Bind(1, L"mary"), std::out_of_range);
+}
+
+TEST_F(DatabaseTest, FetchWithExpressions) {
+	const auto& db = Database::Instance();
+
+	std::vector<Person> persons;
+
+	persons.push_back({L"john", L"appleseed", 28, false, 3});
+	persons.push_back({L"john", L"doe", 45, true, 5});
+	persons.push_back({L"mary", L"poppins", 52, true, 8});
+
+	db.Save(persons);
+
+	const auto older_johns = col(&Person::age) > 30 && col(&Person::first_name) == L"john";
+	const auto fetched_persons = db.Fetch<Person>(&older_johns);
+	ASSERT_EQ(1, fetched_persons.size());
+	EXPECT_EQ(5, fetched_persons[0].id);
+
+	const auto vaccinated_or_young = col(&Person::is_vaccinated) == true || col(&Person::age) < 30;
+	EXPECT_EQ(3, db.Count<Person>(&vaccinated_or_young));
+}
+
+TEST_F(DatabaseTest, FullTextSearch) {
+	const auto& db = Database::Instance();
+
+	std::vector<Article> articles;
+
+	articles.push_back({L"Paul", L"Main street renovation", L"The main street of Springfield reopens", 20, 1});
+	articles.push_back({L"Allen", L"Ocean avenue", L"A new harbour for Houston", 15, 2});
+	articles.push_back({L"Teddy", L"Main square", L"Concerts on the main square of Oslo", 20, 3});
+	articles.push_back({L"Mark", L"Main street, again", L"Main street in Houston gets a main street festival", 65, 4});
+
+	db.Save(articles);
+
+	const auto main_street = Match(&Article::title, L"\"main street\"");
+	const auto fetched_articles = db.Fetch<Article>(&main_street, OrderBy(&Article::id));
+	ASSERT_EQ(2, fetched_articles.size());
+	EXPECT_EQ(1, fetched_articles[0].id);
+	EXPECT_EQ(4, fetched_articles[1].id);
+
+	const auto ranked_articles = db.Search(&Article::body, L"main");
+	ASSERT_EQ(3, ranked_articles.size());
+	EXPECT_EQ(4, ranked_articles[0].id);
+
+	EXPECT_EQ(1, db.Search(&Article::body, L"hous*", 1).size());
+	EXPECT_EQ(2, db.Search(&Article::body, L"main", 2).size());
+
+	auto updated_article = articles[1];
+	updated_article.body = L"A new harbour for Bergen";
+	db.Update(updated_article);
+	db.Delete(articles[3]);
+
+	EXPECT_EQ(0, db.Search(&Article::body, L"houston").size());
+	EXPECT_EQ(1, db.Search(&Article::body, L"bergen").size());
+	EXPECT_EQ(1, db.Search(&Article::title, L"ocean").size());
+
+	// assigning members which are not indexed leaves the full-text index untouched
+	auto trigger = db.Query("SELECT sql FROM sqlite_master WHERE name = 'Article_fts_update'");
+	ASSERT_TRUE(trigger.Next());
+	EXPECT_NE(std::wstring::npos, trigger.GetWideText(0).find(L"AFTER UPDATE OF title, body ON Article"));
+	db.Sql("UPDATE Article SET views = views + 1");
+	EXPECT_EQ(1, db.Search(&Article::body, L"bergen").size());
+
+	EXPECT_THROW(Match(&Article::author, L"paul"), std::invalid_argument);
+}
+
+TEST_F(DatabaseTest, FetchWithTextPatterns) {
+	const auto& db = Database::Instance();
+	db.CreateIndex(&Person::first_name);
+	db.CreateIndex(&Person::last_name, true);
+
+	std::vector<Person> persons;
+
+	persons.push_back({L"john", L"Appleseed", 28, false, 3});
+	persons.push_back({L"Johanna", L"apple_pie", 20, true, 5});
+	persons.push_back({L"mary", L"poppins", 52, true, 8});
+	persons.push_back({L"jonas", L"applebee", 34, false, 9});
+
+	db.Save(persons);
+
+	const auto jo = StartsWith(&Person::first_name, L"jo");
+	EXPECT_EQ(2, db.Count<Person>(&jo));
+
+	const auto case_insensitive_jo = StartsWith(&Person::first_name, L"JO", false);
+	EXPECT_EQ(3, db.Count<Person>(&case_insensitive_jo));
+
+	const auto apple = StartsWith(&Person::last_name, L"apple", false);
+	EXPECT_EQ(3, db.Count<Person>(&apple));
+
+	const auto apple_underscore = StartsWith(&Person::last_name, L"apple_", false);
+	EXPECT_EQ(1, db.Count<Person>(&apple_underscore));
+
+	const auto ends_with_s = EndsWith(&Person::last_name, L"S", false);
+	EXPECT_EQ(1, db.Count<Person>(&ends_with_s));
+
+	const auto contains_pp = Contains(&Person::last_name, L"pp");
+	EXPECT_EQ(4, db.Count<Person>(&contains_pp));
+
+	const auto contains_upper_a = Contains(&Person::last_name, L"A");
+	EXPECT_EQ(1, db.Count<Person>(&contains_upper_a));
+}
+
+class DatabaseMigrationTest : public ::testing::Test
+{
+protected:
+	void SetUp() override {
+		path_ = ::testing::TempDir() + "sqlite_reflection_migration.db";
+		std::remove(path_.data());
+	}
+
+	void TearDown() override {
+		Database::Finalize();
+		std::remove(path_.data());
+	}
+
+	/// Returns the version of the schema of the database file, which SQLite increments on every schema change
+	static int64_t SchemaVersion(const Database& db) {
+		auto cursor = db.Query("PRAGMA schema_version");
+		return cursor.Next() ? cursor.GetInt64(0) : -1;
+	}
+
+	/// Returns the schema hash which was recorded for a given record table during its last migration
+	static int64_t RecordedSchemaHash(const Database& db, const std::string& record_name) {
+		auto cursor = db.Query("SELECT hash FROM _reflection_schema WHERE name = ?", record_name);
+		return cursor.Next() ? cursor.GetInt64(0) : 0;
+	}
+
+	std::string path_;
+};
+
+TEST_F(DatabaseMigrationTest, AddedColumnsAreMigrated) {
+	// simulate a table created before the name member was added to Pet
+	Database::Initialize(path_);
+	Database::Instance().Sql("DROP TABLE Pet");
+	Database::Instance().Sql("CREATE TABLE Pet (id INTEGER PRIMARY KEY, weight REAL)");
+	Database::Instance().Sql("INSERT INTO Pet (id, weight) VALUES (1, 4.5)");
+	Database::Instance().Sql("DELETE FROM _reflection_schema WHERE name = 'Pet'");
+	Database::Finalize();
+
+	Database::Initialize(path_);
+	const auto& db = Database::Instance();
+
+	const auto migrated_pet = db.Fetch<Pet>(1);
+	EXPECT_EQ(L"", migrated_pet.name);
+	EXPECT_EQ(4.5, migrated_pet.weight);
+
+	db.Save(Pet{L"garfield", 7.3, 2});
+	const auto saved_pet = db.Fetch<Pet>(2);
+	EXPECT_EQ(L"garfield", saved_pet.name);
+	EXPECT_EQ(7.3, saved_pet.weight);
+}
+
+TEST_F(DatabaseMigrationTest, UpToDateTablesAreSkipped) {
+	int64_t schema_version = 0;
+	int64_t article_hash = 0;
+	{
+		Database db(path_);
+		schema_version = SchemaVersion(db);
+		article_hash = RecordedSchemaHash(db, "Article");
+	}
+	EXPECT_GT(schema_version, 0);
+	EXPECT_NE(0, article_hash);
+
+	// migrating any table again, even one without new columns, would recreate the full-text index of Article
+	Database db(path_);
+	EXPECT_EQ(schema_version, SchemaVersion(db));
+	EXPECT_EQ(article_hash, RecordedSchemaHash(db, "Article"));
+}
+
+TEST_F(DatabaseMigrationTest, ChangedEncodingsAreDetected) {
+	// simulate a table created while the counts of Sensor were delta-encoded, which is stored as a BLOB column as well
+	auto previous_sensor = GetRecordFromTypeId(typeid(Sensor).name());
+	for (auto& member : previous_sensor.member_metadata) {
+		if (member.name == "counts") {
+			member.storage_class = SqliteStorageClass::kIntArrayDelta;
+		}
+	}
+	const auto current_hash = (int64_t)SchemaHash(GetRecordFromTypeId(typeid(Sensor).name()));
+	const auto previous_hash = (int64_t)SchemaHash(previous_sensor);
+	ASSERT_NE(current_hash, previous_hash);
+
+	{
+		Database db(path_);
+		db.Sql("UPDATE _reflection_schema SET hash = " + std::to_string(previous_hash) + " WHERE name = 'Sensor'");
+	}
+
+	Database db(path_);
+	EXPECT_EQ(current_hash, RecordedSchemaHash(db, "Sensor"));
+}
+
+TEST(DatabaseLazyTableCreationTest, TablesAreCreatedOnFirstUse) {
+	Database::Initialize("", TableCreation::kLazy);
+	const auto& db = Database::Instance();
+
+	// no table exists before its record type is used
+	EXPECT_THROW(db.Sql("DELETE FROM Pet"), std::domain_error);
+
+	EXPECT_EQ(0, db.FetchAll<Pet>().size());
+	db.SaveAutoIncrement(Pet{L"garfield", 7.3});
+	EXPECT_EQ(1, db.Fetch<Pet>(1).id);
+	EXPECT_NO_THROW(db.Sql("DELETE FROM Pet"));
+
+	Database::Finalize();
+}
+
+TEST_F(DatabaseTest, Instrumentation) {
+	const auto& db = Database::Instance();
+
+	db.Save(Person{L"john", L"appleseed", 28, false, 3});
+	EXPECT_EQ(0, db.Stats().operations.size());
+
+	db.EnableInstrumentation(0.0);
+
+	db.Save(Person{L"mary", L"poppins", 20, true, 5});
+	db.FetchAll<Person>();
+	const auto mary = Equal(&Person::first_name, L"mary");
+	db.Fetch<Person>(&mary);
+	db.Count<Person>();
+
+	const auto statistics = db.Stats();
+
+	const auto& fetch = statistics.operations.at(std::make_pair(std::string("Person"), std::string("Fetch")));
+	EXPECT_EQ(2, fetch.latency.Count());
+	EXPECT_EQ(3, fetch.rows);
+	EXPECT_LT(0, fetch.bytes);
+	EXPECT_LE(fetch.latency.P50(), fetch.latency.P99());
+
+	EXPECT_EQ(1, statistics.operations.at(std::make_pair(std::string("Person"), std::string("Save"))).latency.Count());
+	EXPECT_EQ(1, statistics.operations.at(std::make_pair(std::string("Person"), std::string("Aggregate"))).latency.Count());
+	EXPECT_LE(4, statistics.statements.Count());
+
+	// with a zero threshold, every statement is logged as slow
+	ASSERT_FALSE(statistics.slow_queries.empty());
+	const auto& fetch_by_name = std::find_if(statistics.slow_queries.begin(), statistics.slow_queries.end(), [](const SlowQuery& query) {
+		return query.sql.find("WHERE first_name = 'mary'") != std::string::npos;
+	});
+	ASSERT_NE(statistics.slow_queries.end(), fetch_by_name);
+	EXPECT_NE(std::string::npos, fetch_by_name->query_plan.find("SCAN Person"));
+
+	db.DisableInstrumentation();
+	EXPECT_EQ(0, db.Stats().operations.size());
+}
@@ -22,9 +22,17 @@
 
 #include <gtest/gtest.h>
 #include "query_predicates.h"
+#include "query_ordering.h"
+#include "query_expressions.h"
 
 #include "person.h"
 #include "pet.h"
+#include "company.h"
+#include "device.h"
+#include "attachment.h"
+#include "sensor.h"
+#include "article.h"
+#include "audit_entry.h"
 
 using namespace sqlite_reflection;
 
@@ -137,3 +145,178 @@ TEST(QueryPredicatesTest, PredicateChaining) {
 
 	EXPECT_EQ(0, strcmp(evaluation.data(), "((id = 65 OR first_name = 'john') AND last_name != 'appleseed')"));
 }
+
+TEST(QueryPredicatesTest, OrderingChaining) {
+	const auto ordering = OrderBy(&Person::age, Direction::kDescending)
+	                      .ThenBy(&Person::last_name);
+
+	const auto evaluation = ordering.Evaluate();
+
+	EXPECT_EQ(0, strcmp(evaluation.data(), "age DESC, last_name ASC"));
+}
+
+TEST(QueryPredicatesTest, InInt) {
+	const In condition(&Person::id, std::vector<int64_t>{3, 5, 8});
+	const auto evalution = condition.Evaluate();
+	EXPECT_EQ(0, strcmp(evalution.data(), "id IN (3, 5, 8)"));
+}
+
+TEST(QueryPredicatesTest, InString) {
+	const In condition(&Person::first_name, std::vector<std::wstring>{L"john", L"mary"});
+	const auto evalution = condition.Evaluate();
+	EXPECT_EQ(0, strcmp(evalution.data(), "first_name IN ('john', 'mary')"));
+}
+
+TEST(QueryPredicatesTest, InLongListBindsJsonArray) {
+	std::vector<std::wstring> names(20, L"a\"b");
+	names[0] = L"o'neil";
+	const In condition(&Person::first_name, names);
+
+	std::vector<QueryParameter> parameters;
+	const auto evaluation = condition.Evaluate(parameters);
+	EXPECT_EQ(0, strcmp(evaluation.data(), "first_name IN (SELECT value FROM json_each(?))"));
+	ASSERT_EQ(1, parameters.size());
+	EXPECT_EQ(0, parameters[0].text_value.find("[\"o'neil\",\"a\\\"b\","));
+}
+
+TEST(QueryPredicatesTest, PatternsOnCompressedText) {
+	EXPECT_THROW(Like(&AuditEntry::payload, L"login"), std::domain_error);
+	EXPECT_THROW(StartsWith(&AuditEntry::payload, L"{"), std::domain_error);
+	EXPECT_THROW(EndsWith(&AuditEntry::payload, L"}", false), std::domain_error);
+	EXPECT_THROW(Contains(&AuditEntry::payload, L"login"), std::domain_error);
+
+	const Equal condition(&AuditEntry::payload, L"{}");
+	const auto evaluation = condition.Evaluate();
+	EXPECT_EQ(0, strcmp(evaluation.data(), "payload = X'007B7D'"));
+}
+
+TEST(QueryPredicatesTest, BetweenDouble) {
+	const Between condition(&Pet::weight, 2.5, 32.4);
+	const auto evalution = condition.Evaluate();
+	EXPECT_EQ(0, strcmp(evalution.data(), "weight BETWEEN 2.5 AND 32.4"));
+}
+
+TEST(QueryPredicatesTest, BetweenChaining) {
+	const auto predicate = Between(&Person::age, 20, 30)
+	                       .And(In(&Person::id, std::vector<int>{1, 2}));
+
+	const auto evaluation = predicate.Evaluate();
+
+	EXPECT_EQ(0, strcmp(evaluation.data(), "(age BETWEEN 20 AND 30 AND id IN (1, 2))"));
+}
+
+TEST(QueryPredicatesTest, ParameterizedEvaluation) {
+	const auto predicate = Equal(&Person::first_name, L"o'neil")
+	                       .And(Between(&Person::age, 20, 30));
+
+	std::vector<QueryParameter> parameters;
+	const auto evaluation = predicate.Evaluate(parameters);
+
+	EXPECT_EQ(0, strcmp(evaluation.data(), "(first_name = ? AND age BETWEEN ? AND ?)"));
+	ASSERT_EQ(3, parameters.size());
+	EXPECT_EQ("o'neil", parameters[0].text_value);
+	EXPECT_EQ(20, parameters[1].int_value);
+	EXPECT_EQ(30, parameters[2].int_value);
+
+	const auto literal_evaluation = predicate.Evaluate();
+	EXPECT_EQ(0, strcmp(literal_evaluation.data(), "(first_name = 'o''neil' AND age BETWEEN 20 AND 30)"));
+}
+
+TEST(QueryPredicatesTest, Expressions) {
+	const auto predicate = (col(&Person::age) > 30 && col(&Person::first_name) == L"john")
+	                       || col(&Pet::weight) <= 2.5;
+
+	const auto evaluation = predicate.Evaluate();
+	EXPECT_EQ(0, strcmp(evaluation.data(), "((age > 30 AND first_name = 'john') OR weight <= 2.5)"));
+
+	std::vector<QueryParameter> parameters;
+	const auto parameterized_evaluation = predicate.Evaluate(parameters);
+	EXPECT_EQ(0, strcmp(parameterized_evaluation.data(), "((age > ? AND first_name = ?) OR weight <= ?)"));
+	ASSERT_EQ(3, parameters.size());
+	EXPECT_EQ(30, parameters[0].int_value);
+	EXPECT_EQ("john", parameters[1].text_value);
+	EXPECT_EQ(2.5, parameters[2].real_value);
+}
+
+TEST(QueryPredicatesTest, ExpressionsRejectNarrowingValues) {
+	EXPECT_TRUE((IsNonNarrowingConversion<int, int64_t>::value));
+	EXPECT_TRUE((IsNonNarrowingConversion<double, double>::value));
+	EXPECT_TRUE((IsNonNarrowingConversion<wchar_t[5], std::wstring>::value));
+	EXPECT_FALSE((IsNonNarrowingConversion<double, int64_t>::value));
+	EXPECT_FALSE((IsNonNarrowingConversion<int64_t, bool>::value));
+	EXPECT_FALSE((IsNonNarrowingConversion<double, float>::value));
+}
+
+TEST(QueryPredicatesTest, ExpressionsMixedWithPredicates) {
+	const auto predicate = (col(&Person::id) != 3).And(Equal(&Person::is_vaccinated, true));
+
+	const auto evaluation = predicate.Evaluate();
+
+	EXPECT_EQ(0, strcmp(evaluation.data(), "(id != 3 AND is_vaccinated = 1)"));
+}
+
+TEST(QueryPredicatesTest, Match) {
+	const Match condition(&Article::body, L"main street");
+	const auto evalution = condition.Evaluate();
+	EXPECT_EQ(0, strcmp(evalution.data(), "id IN (SELECT rowid FROM Article_fts WHERE body MATCH 'main street')"));
+}
+
+TEST(QueryPredicatesTest, StartsWith) {
+	const StartsWith condition(&Person::first_name, L"jo");
+	const auto evalution = condition.Evaluate();
+	EXPECT_EQ(0, strcmp(evalution.data(), "first_name >= 'jo' AND first_name < 'jp'"));
+
+	const StartsWith case_insensitive_condition(&Person::first_name, L"j_o", false);
+	const auto case_insensitive_evalution = case_insensitive_condition.Evaluate();
+	EXPECT_EQ(0, strcmp(case_insensitive_evalution.data(), "first_name LIKE 'j\\_o%' ESCAPE '\\'"));
+}
+
+TEST(QueryPredicatesTest, EndsWithAndContains) {
+	const EndsWith ends_with(&Person::last_name, L"seed*");
+	const auto ends_with_evalution = ends_with.Evaluate();
+	EXPECT_EQ(0, strcmp(ends_with_evalution.data(), "last_name GLOB '*seed[*]'"));
+
+	const Contains contains(&Person::last_name, L"10%", false);
+	const auto contains_evalution = contains.Evaluate();
+	EXPECT_EQ(0, strcmp(contains_evalution.data(), "last_name LIKE '%10\\%%' ESCAPE '\\'"));
+}
+
+TEST(QueryPredicatesTest, Utf8Text) {
+	const auto equal = Equal(&Device::serial_number, "SN-001");
+	EXPECT_EQ(0, strcmp(equal.Evaluate().data(), "serial_number = 'SN-001'"));
+
+	const StartsWith starts_with(&Device::serial_number, "SN");
+	EXPECT_EQ(0, strcmp(starts_with.Evaluate().data(), "serial_number >= 'SN' AND serial_number < 'SO'"));
+
+	// the prefix is bound as it is, even with embedded NUL and bytes which are not valid UTF-8
+	const StartsWith raw_prefix(&Device::serial_number, std::string("S\0N\xFF", 4));
+	std::vector<QueryParameter> parameters;
+	EXPECT_EQ(0, strcmp(raw_prefix.Evaluate(parameters).data(), "serial_number >= ? AND serial_number < ?"));
+	ASSERT_EQ(2, parameters.size());
+	EXPECT_EQ(std::string("S\0N\xFF", 4), parameters[0].text_value);
+	EXPECT_EQ(std::string("S\0O", 3), parameters[1].text_value);
+
+	const Contains contains(&Device::serial_number, "0_1", false);
+	EXPECT_EQ(0, strcmp(contains.Evaluate().data(), "serial_number LIKE '%0\\_1%' ESCAPE '\\'"));
+
+	const auto expression = col(&Device::serial_number) != "SN-002";
+	EXPECT_EQ(0, strcmp(expression.Evaluate().data(), "serial_number != 'SN-002'"));
+}
+
+TEST(QueryPredicatesTest, Blob) {
+	const auto equal = Equal(&Attachment::content, std::vector<uint8_t>{0x00, 0x1F, 0xFF});
+	EXPECT_EQ(0, strcmp(equal.Evaluate().data(), "content = X'001FFF'"));
+
+	std::vector<QueryParameter> parameters;
+	EXPECT_EQ(0, strcmp(equal.Evaluate(parameters).data(), "content = ?"));
+	ASSERT_EQ(1, parameters.size());
+	EXPECT_EQ(std::string("\x00\x1F\xFF", 3), parameters[0].text_value);
+}
+
+TEST(QueryPredicatesTest, PackedArrays) {
+	const auto equal_counts = Equal(&Sensor::counts, std::vector<int64_t>{1, -1});
+	EXPECT_EQ(0, strcmp(equal_counts.Evaluate().data(), "counts = X'0100000000000000FFFFFFFFFFFFFFFF'"));
+
+	const auto equal_timestamps = Equal(&Sensor::timestamps, std::vector<int64_t>{100, 101, 99});
+	EXPECT_EQ(0, strcmp(equal_timestamps.Evaluate().data(), "timestamps = X'C8010203'"));
+}